@@ -0,0 +1,241 @@
+#ifndef AUTO_SPARSE_MATRIX_H
+#define AUTO_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+#include "SoASparseMatrix.h"
+#include "CompressedSparseMatrix.h"
+#include "DiaSparseMatrix.h"
+#include "HybSparseMatrix.h"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+/**
+ Formati di memorizzazione tra cui sceglie l'analizzatore
+*/
+enum sparse_format {
+	csr_format, ///< righe compresse, SoASparseMatrix
+	compressed_format, ///< righe compresse con indici codificati, CompressedSparseMatrix
+	dia_format, ///< diagonali, DiaSparseMatrix
+	hyb_format ///< ELLPACK + COO, HybSparseMatrix
+};
+
+/**
+ Operazioni per cui si puo' chiedere il formato migliore
+*/
+enum sparse_operation {
+	spmv_operation, ///< prodotto matrice-vettore ripetuto
+	lookup_operation, ///< letture casuali di singole caselle
+	storage_operation ///< minima occupazione di memoria
+};
+
+/**
+ Statistiche sulla struttura di una matrice usate per scegliere il formato
+*/
+struct sparse_stats {
+	uint64_t righe; ///< numero di righe
+	uint64_t nnz; ///< numero di elementi
+	uint64_t max_riga; ///< numero massimo di elementi in una riga
+	double media; ///< numero medio di elementi per riga
+	double deviazione; ///< deviazione standard del numero di elementi per riga
+	uint64_t diagonali; ///< numero di diagonali occupate
+};
+
+/**
+ Calcola le statistiche di una SparseMatrix con una scansione degli elementi
+
+ @param M matrice da analizzare
+*/
+template <typename T, typename Index>
+sparse_stats analyze(const SparseMatrix<T, Index>& M) {
+	sparse_stats s;
+	s.righe = (uint64_t)M.get_righe();
+	s.nnz = M.get_size();
+	s.max_riga = 0;
+	s.diagonali = DiaSparseMatrix<T, Index>::find_diagonals(M).size();
+	std::vector<uint64_t> lunghezze((size_t)s.righe, 0);
+	typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+	for (; Ib != Ie; ++Ib)
+		++lunghezze[(*Ib).riga - 1];
+	s.media = (double)s.nnz / (double)s.righe;
+	double varianza = 0;
+	for (size_t i = 0; i < lunghezze.size(); ++i) {
+		s.max_riga = std::max(s.max_riga, lunghezze[i]);
+		varianza += ((double)lunghezze[i] - s.media) * ((double)lunghezze[i] - s.media);
+	}
+	s.deviazione = std::sqrt(varianza / (double)s.righe);
+	return s;
+}
+
+/**
+ Sceglie il formato per un'operazione in base alle statistiche:
+ - spmv: DIA se le diagonali occupate hanno al massimo il doppio di caselle
+   degli elementi, HYB se le lunghezze delle righe sono molto irregolari
+   (deviazione standard maggiore della media), altrimenti righe compresse;
+ - letture casuali: righe compresse, riga in O(1) e ricerca binaria;
+ - memoria: DIA se quasi senza riempimento (nessun indice per elemento),
+   altrimenti righe con indici codificati.
+
+ @param s statistiche della matrice
+ @param op operazione
+*/
+inline sparse_format choose_format(const sparse_stats& s, const sparse_operation op) {
+	const double caselle_dia = (double)s.diagonali * (double)s.righe;
+	switch (op) {
+	case spmv_operation:
+		if (s.nnz > 0 && caselle_dia <= 2.0 * (double)s.nnz)
+			return dia_format;
+		if (s.deviazione > s.media)
+			return hyb_format;
+		return csr_format;
+	case lookup_operation:
+		return csr_format;
+	default:
+		if (s.nnz > 0 && caselle_dia <= 1.25 * (double)s.nnz)
+			return dia_format;
+		return compressed_format;
+	}
+}
+
+/**
+ Matrice che sceglie da sola il formato di memorizzazione: analizza una volta
+ la struttura di una SparseMatrix, ricorda il formato scelto per ciascuna
+ operazione e costruisce ogni formato solo la prima volta che serve, poi lo
+ riusa. Nel costruttore copia la matrice a righe compresse, il formato delle
+ letture casuali, e da quella copia costruisce gli altri formati: la matrice di
+ partenza non viene piu' usata e puo' essere modificata o distrutta.
+
+ @brief matrice con selezione automatica del formato
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class AutoSparseMatrix {
+	sparse_stats stats; ///< statistiche della matrice di partenza
+	int scelte[3]; ///< formato scelto per ogni operazione, -1 se non ancora scelto
+	SoASparseMatrix<T, Index> csr; ///< copia a righe compresse della matrice di partenza
+	std::unique_ptr<CompressedSparseMatrix<T, Index> > compressa; ///< costruita alla prima richiesta
+	std::unique_ptr<DiaSparseMatrix<T, Index> > dia; ///< costruita alla prima richiesta
+	std::unique_ptr<HybSparseMatrix<T, Index> > hyb; ///< costruita alla prima richiesta
+
+	AutoSparseMatrix(const AutoSparseMatrix&); // non copiabile
+	AutoSparseMatrix& operator=(const AutoSparseMatrix&);
+
+public:
+	/**
+	 Costruttore, analizza la matrice e ne tiene una copia a righe compresse
+
+	 @param m matrice di partenza
+	 @throw eccezione di allocazione di memoria
+	*/
+	explicit AutoSparseMatrix(const SparseMatrix<T, Index>& m) : stats(analyze(m)), csr(m) {
+		for (int k = 0; k < 3; ++k)
+			scelte[k] = -1;
+	}
+
+	/**
+	 Ritorna le statistiche della matrice
+	*/
+	const sparse_stats& get_stats() const {
+		return stats;
+	}
+
+	/**
+	 Ritorna il formato per l'operazione op, scegliendolo alla prima richiesta
+
+	 @param op operazione
+	*/
+	sparse_format format_for(const sparse_operation op) {
+		if (scelte[op] < 0)
+			scelte[op] = choose_format(stats, op);
+		return (sparse_format)scelte[op];
+	}
+
+	/**
+	 Ritorna la matrice a righe compresse
+	*/
+	const SoASparseMatrix<T, Index>& get_csr() const {
+		return csr;
+	}
+
+	/**
+	 Ritorna la matrice con indici compressi, costruendola dalla copia se serve
+	*/
+	const CompressedSparseMatrix<T, Index>& get_compressed() {
+		if (!compressa)
+			compressa.reset(new CompressedSparseMatrix<T, Index>(csr));
+		return *compressa;
+	}
+
+	/**
+	 Ritorna la matrice a diagonali, costruendola dalla copia se serve
+	*/
+	const DiaSparseMatrix<T, Index>& get_dia() {
+		if (!dia)
+			dia.reset(new DiaSparseMatrix<T, Index>(csr));
+		return *dia;
+	}
+
+	/**
+	 Ritorna la matrice ibrida, costruendola dalla copia se serve
+	*/
+	const HybSparseMatrix<T, Index>& get_hyb() {
+		if (!hyb)
+			hyb.reset(new HybSparseMatrix<T, Index>(csr));
+		return *hyb;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x nel formato scelto per spmv
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) {
+		switch (format_for(spmv_operation)) {
+		case dia_format:
+			get_dia().spmv(x, y);
+			break;
+		case hyb_format:
+			get_hyb().spmv(x, y);
+			break;
+		case compressed_format:
+			get_compressed().spmv(x, y);
+			break;
+		default:
+			get_csr().spmv(x, y);
+		}
+	}
+
+	/**
+	 Ritorna il valore in (r;c) nel formato scelto per le letture casuali
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) {
+		switch (format_for(lookup_operation)) {
+		case dia_format:
+			return get_dia()(r, c);
+		case hyb_format:
+			return get_hyb()(r, c);
+		case compressed_format:
+			return get_compressed()(r, c);
+		default:
+			return get_csr()(r, c);
+		}
+	}
+};
+
+/**
+ Prodotto matrice-vettore nel formato scelto automaticamente
+
+ @param M matrice con selezione automatica del formato
+ @param x vettore di colonne elementi
+ @param y vettore di righe elementi
+*/
+template <typename T, typename Index>
+void spmv(AutoSparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
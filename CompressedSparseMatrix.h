@@ -0,0 +1,330 @@
+#ifndef COMPRESSED_SPARSE_MATRIX_H
+#define COMPRESSED_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+
+#ifdef __SSSE3__
+	#include <tmmintrin.h>
+#endif
+
+/**
+ Codec degli indici di colonna in stile stream-vbyte. Per ogni riga le colonne
+ vengono codificate come differenze dalla precedente (la prima rispetto a 0),
+ e ogni differenza occupa da 1 a 4 byte. Le lunghezze sono raccolte a parte in
+ byte di controllo da 2 bit per valore, cosi' la decodifica di 4 valori alla
+ volta si riduce a un unico shuffle di byte (SSSE3, se il compilatore lo abilita)
+ o a un ciclo senza salti imprevedibili.
+ Formato di una riga di n valori: ceil(n/4) byte di controllo seguiti dai dati.
+
+ @brief codifica compressa degli indici di colonna
+*/
+struct column_codec {
+	/**
+	 Numero di byte usati per il valore v
+	*/
+	static unsigned length(const uint32_t v) {
+		return (v < (1u << 8)) ? 1 : (v < (1u << 16)) ? 2 : (v < (1u << 24)) ? 3 : 4;
+	}
+
+	/**
+	 Accoda a out la codifica delle colonne cols[0..n-1], in ordine crescente
+
+	 @param cols colonne della riga
+	 @param n numero di colonne
+	 @param out byte codificati
+	*/
+	static void encode(const uint32_t* cols, const size_t n, std::vector<uint8_t>& out) {
+		const size_t ctrl = out.size();
+		out.resize(out.size() + (n + 3) / 4, 0);
+		uint32_t prec = 0;
+		for (size_t k = 0; k < n; ++k) {
+			const uint32_t d = cols[k] - prec;
+			prec = cols[k];
+			const unsigned len = length(d);
+			out[ctrl + k / 4] |= (uint8_t)((len - 1) << (2 * (k % 4)));
+			for (unsigned b = 0; b < len; ++b)
+				out.push_back((uint8_t)(d >> (8 * b)));
+		}
+	}
+
+	/**
+	 Decodifica n colonne a partire da p. Se abilitato SSSE3 decodifica 4 valori per
+	 volta e puo' leggere fino a 16 byte oltre la fine della riga: lo stream deve
+	 essere seguito da almeno 16 byte di riempimento.
+
+	 @param p inizio della riga codificata
+	 @param n numero di colonne
+	 @param out n colonne decodificate
+	*/
+	static void decode(const uint8_t* p, const size_t n, uint32_t* out) {
+		const uint8_t* ctrl = p;
+		const uint8_t* data = p + (n + 3) / 4;
+		size_t k = 0;
+#ifdef __SSSE3__
+		const table& t = get_table();
+		for (; k + 4 <= n; k += 4) {
+			const uint8_t c = ctrl[k / 4];
+			__m128i v = _mm_loadu_si128((const __m128i*)data);
+			v = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i*)t.shuffle[c]));
+			_mm_storeu_si128((__m128i*)(out + k), v);
+			data += t.bytes[c];
+		}
+#endif
+		for (; k < n; ++k) {
+			const unsigned len = ((ctrl[k / 4] >> (2 * (k % 4))) & 3) + 1;
+			uint32_t v = 0;
+			for (unsigned b = 0; b < len; ++b)
+				v |= (uint32_t)data[b] << (8 * b);
+			data += len;
+			out[k] = v;
+		}
+		uint32_t prec = 0;
+		for (k = 0; k < n; ++k) {
+			prec += out[k];
+			out[k] = prec;
+		}
+	}
+
+	/**
+	 Cerca la colonna c tra le n colonne codificate a partire da p, decodificando
+	 solo fino alla prima colonna >= c
+
+	 @param p inizio della riga codificata
+	 @param n numero di colonne
+	 @param c colonna cercata
+	 @return posizione di c nella riga, n se non presente
+	*/
+	static size_t find(const uint8_t* p, const size_t n, const uint32_t c) {
+		const uint8_t* ctrl = p;
+		const uint8_t* data = p + (n + 3) / 4;
+		uint32_t col = 0;
+		for (size_t k = 0; k < n; ++k) {
+			const unsigned len = ((ctrl[k / 4] >> (2 * (k % 4))) & 3) + 1;
+			uint32_t v = 0;
+			for (unsigned b = 0; b < len; ++b)
+				v |= (uint32_t)data[b] << (8 * b);
+			data += len;
+			col += v;
+			if (col >= c)
+				return (col == c) ? k : n;
+		}
+		return n;
+	}
+
+#ifdef __SSSE3__
+	/**
+	 Tabelle di decodifica SIMD indicizzate dal byte di controllo
+	*/
+	struct table {
+		uint8_t shuffle[256][16]; ///< maschera di shuffle che espande 4 valori in 4 uint32_t
+		uint8_t bytes[256]; ///< byte di dati consumati dai 4 valori
+	};
+
+	/**
+	 Ritorna le tabelle, costruite una sola volta
+	*/
+	static const table& get_table() {
+		static const table t = build_table();
+		return t;
+	}
+
+	/**
+	 Costruisce le tabelle di decodifica
+	*/
+	static table build_table() {
+		table t;
+		for (unsigned c = 0; c < 256; ++c) {
+			unsigned pos = 0;
+			for (unsigned k = 0; k < 4; ++k) {
+				const unsigned len = ((c >> (2 * k)) & 3) + 1;
+				for (unsigned b = 0; b < 4; ++b)
+					t.shuffle[c][4 * k + b] = (b < len) ? (uint8_t)(pos + b) : 0x80;
+				pos += len;
+			}
+			t.bytes[c] = (uint8_t)pos;
+		}
+		return t;
+	}
+#endif
+};
+
+/**
+ Matrice sparsa in sola lettura con indici di colonna compressi (vedi column_codec),
+ costruita a partire da una SparseMatrix. Il codec lavora su 32 bit, quindi
+ il numero di colonne non puo' superare 2^32 - 1 anche se Index e' piu' largo. Pensata per matrici lette molte volte:
+ gli indici occupano tipicamente 1-2 byte invece di 4, e il prodotto matrice-vettore,
+ limitato dalla banda di memoria, legge meno byte nonostante il costo di decodifica.
+
+ @brief matrice sparsa con indici compressi
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class CompressedSparseMatrix {
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	std::vector<uint64_t> row_ptr; ///< la riga r ha i valori in [row_ptr[r-1];row_ptr[r])
+	std::vector<uint64_t> row_off; ///< la riga r e' codificata a partire da indici[row_off[r-1]]
+	std::vector<uint8_t> indici; ///< colonne codificate, seguite da 16 byte di riempimento
+	std::vector<T> vals; ///< valori in ordine naturale
+	size_t max_riga; ///< numero massimo di elementi in una riga
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento esposto dall'iteratore
+
+	/**
+	 Costruttore, comprime una SparseMatrix o una SoASparseMatrix
+
+	 @param M matrice da comprimere
+	 @throw std::length_error se le colonne non entrano in 32 bit
+	 @throw eccezione di allocazione di memoria
+	*/
+	template <typename Sorgente>
+	explicit CompressedSparseMatrix(const Sorgente& M) : righe(M.get_righe()), colonne(M.get_colonne()), D(M.get_default()),
+			row_ptr(M.get_righe() + 1, 0), row_off(M.get_righe() + 1, 0), max_riga(0) {
+		if ((uint64_t)colonne > 0xFFFFFFFFu) // il codec scrive colonne a 32 bit
+			throw std::length_error("CompressedSparseMatrix: le colonne non entrano in 32 bit");
+		vals.reserve(M.get_size());
+		std::vector<uint32_t> cols;
+		typename Sorgente::const_iterator Ib = M.begin(), Ie = M.end();
+		for (Index i = 0; i < righe; ++i) {
+			cols.clear();
+			for (; Ib != Ie && (*Ib).riga - 1 == i; ++Ib) {
+				cols.push_back((uint32_t)(*Ib).colonna);
+				vals.push_back((*Ib).dato);
+			}
+			column_codec::encode(cols.data(), cols.size(), indici);
+			row_ptr[i + 1] = vals.size();
+			row_off[i + 1] = indici.size();
+			max_riga = std::max(max_riga, cols.size());
+		}
+		indici.resize(indici.size() + 16, 0);
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	size_t get_size() const {
+		return vals.size();
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Ritorna i byte occupati da indici e valori
+	*/
+	size_t memory_bytes() const {
+		return indici.size() + vals.size() * sizeof(T) + (row_ptr.size() + row_off.size()) * sizeof(uint64_t);
+	}
+
+	/**
+	 Decodifica le colonne della riga r in out, che deve avere spazio per la riga
+
+	 @param r riga
+	 @param out colonne della riga
+	 @return numero di colonne della riga
+	*/
+	size_t decode_row(const Index r, uint32_t* out) const {
+		const size_t n = row_ptr[r] - row_ptr[r - 1];
+		column_codec::decode(&indici[row_off[r - 1]], n, out);
+		return n;
+	}
+
+	/**
+	 Ritorna il valore in (r;c) decodificando la riga r fino alla colonna c
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		const size_t n = row_ptr[r] - row_ptr[r - 1];
+		const size_t k = column_codec::find(&indici[row_off[r - 1]], n, (uint32_t)c);
+		if (k < n)
+			return vals[row_ptr[r - 1] + k];
+		return D;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x, decodificando una riga alla volta.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const default_correction<T> correzione(D, x, colonne);
+		std::vector<uint32_t> cols(max_riga + 4);
+		for (Index i = 0; i < righe; ++i) {
+			const size_t n = decode_row(i + 1, cols.data());
+			const T* v = vals.data() + row_ptr[i];
+			T acc = zero;
+			T somma_memorizzati = zero;
+			for (size_t k = 0; k < n; ++k)
+				acc += v[k] * x[cols[k] - 1];
+			if (correzione.active())
+				for (size_t k = 0; k < n; ++k)
+					somma_memorizzati += x[cols[k] - 1];
+			y[i] = correzione(acc, somma_memorizzati);
+		}
+	}
+
+	/**
+	 Ricostruisce la matrice a lista
+
+	 @return la matrice decompressa
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> decompress() const {
+		SparseMatrix<T, Index> M(righe, colonne, D);
+		std::vector<element> batch;
+		batch.reserve(vals.size());
+		std::vector<uint32_t> cols(max_riga + 4);
+		for (Index i = 0; i < righe; ++i) {
+			const size_t n = decode_row(i + 1, cols.data());
+			for (size_t k = 0; k < n; ++k)
+				batch.push_back(element(i + 1, (Index)cols[k], vals[row_ptr[i] + k]));
+		}
+		M.scatter(batch);
+		return M;
+	}
+};
+
+/**
+ Prodotto matrice-vettore su una matrice compressa
+
+ @param M matrice compressa
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename Index>
+void spmv(const CompressedSparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
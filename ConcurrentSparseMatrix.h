@@ -0,0 +1,293 @@
+#ifndef CONCURRENT_SPARSE_MATRIX_H
+#define CONCURRENT_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ Matrice sparsa per la costruzione parallela: add e operator() possono essere
+ chiamati da piu' thread contemporaneamente senza lock. Ogni riga e' una lista
+ ordinata per colonna, con i collegamenti atomici: un nuovo nodo viene
+ agganciato con un compare-and-swap sul collegamento del predecessore, e se
+ un altro thread ha inserito nello stesso punto la ricerca riparte da li'.
+ I nodi non vengono mai staccati finche' la matrice esiste, quindi non ci
+ sono problemi di ABA ne' di reclamazione. Ogni riga tiene il proprio
+ contatore di elementi accanto alla testa, invece di un contatore globale su
+ cui si contenderebbero tutti gli inserimenti: thread che lavorano su righe
+ diverse si contendono al piu' la cache line delle teste di righe vicine.
+ add e operator() sono linearizzabili: un inserimento ha effetto al CAS che
+ aggancia il nodo, la sovrascrittura di un valore alla sua store atomica.
+ I valori sono std::atomic<T>, quindi T deve essere copiabile byte per byte.
+ Finita la costruzione, to_matrix() produce la SparseMatrix equivalente.
+
+ @brief matrice sparsa con inserimento concorrente senza lock
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class ConcurrentSparseMatrix {
+	/**
+	 Nodo di una riga
+	*/
+	struct node {
+		const Index colonna; ///< posizione colonna
+		std::atomic<T> dato; ///< dato della casella
+		std::atomic<node*> next; ///< nodo successivo nella riga
+
+		node(const Index c, const T& d, node* n) : colonna(c), dato(d), next(n) {}
+	};
+
+	/**
+	 Testa di una riga con il suo contatore, nella stessa cache line
+	*/
+	struct row {
+		std::atomic<node*> head; ///< primo nodo della riga
+		std::atomic<size_t> size; ///< numero di elementi della riga
+	};
+
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	row* row_head; ///< testa di ogni riga
+
+	ConcurrentSparseMatrix(const ConcurrentSparseMatrix&); // non copiabile
+	ConcurrentSparseMatrix& operator=(const ConcurrentSparseMatrix&);
+
+	/**
+	 Cerca nella riga il primo nodo con colonna >= c, partendo dal collegamento link
+
+	 @param link collegamento da cui partire, aggiornato al collegamento che punta al nodo trovato
+	 @param c colonna cercata
+	 @return il nodo trovato, 0 se la riga finisce prima
+	*/
+	static node* search(std::atomic<node*>*& link, const Index c) {
+		node* current = link->load(std::memory_order_acquire);
+		while (current != 0 && current->colonna < c) {
+			link = &current->next;
+			current = link->load(std::memory_order_acquire);
+		}
+		return current;
+	}
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+
+	/**
+	 Costruttore di una matrice vuota
+
+	 @param r numero di righe
+	 @param c numero di colonne
+	 @param d dato di default
+	 @throw eccezione di allocazione di memoria
+	*/
+	ConcurrentSparseMatrix(const Index r, const Index c, const T& d) : righe(r), colonne(c), D(d), row_head(0) {
+		assert(r > 0);
+		assert(c > 0);
+		row_head = new row[(size_t)r];
+		for (Index i = 0; i < r; ++i) {
+			row_head[i].head.store(0, std::memory_order_relaxed);
+			row_head[i].size.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 Distruttore, da chiamare quando nessun thread usa piu' la matrice
+	*/
+	~ConcurrentSparseMatrix() {
+		for (Index i = 0; i < righe; ++i) {
+			node* n = row_head[i].head.load(std::memory_order_relaxed);
+			while (n != 0) {
+				node* next = n->next.load(std::memory_order_relaxed);
+				delete n;
+				n = next;
+			}
+		}
+		delete[] row_head;
+	}
+
+	/**
+	 Ritorna il numero di elementi inseriti, sommando i contatori delle righe in
+	 O(righe). Durante inserimenti concorrenti il risultato e' solo indicativo.
+	*/
+	size_t get_size() const {
+		size_t n = 0;
+		for (Index i = 0; i < righe; ++i)
+			n += row_head[i].size.load(std::memory_order_relaxed);
+		return n;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Inserisce il valore in (r;c), sovrascrivendo quello presente. Puo' essere
+	 chiamato da piu' thread contemporaneamente.
+
+	 @param r riga
+	 @param c colonna
+	 @param dato valore da inserire
+	 @throw eccezione di allocazione di memoria
+	*/
+	void add(const Index r, const Index c, const T& dato) {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		assert(dato != D);
+		std::atomic<node*>* link = &row_head[r - 1].head;
+		node* nuovo = 0;
+		for (;;) {
+			node* current = search(link, c);
+			if (current != 0 && current->colonna == c) {
+				current->dato.store(dato, std::memory_order_release);
+				delete nuovo; // preparato ma superato da un altro thread che ha inserito la stessa casella
+				return;
+			}
+			if (nuovo == 0)
+				nuovo = new node(c, dato, current);
+			else
+				nuovo->next.store(current, std::memory_order_relaxed);
+			if (link->compare_exchange_weak(current, nuovo, std::memory_order_release, std::memory_order_relaxed)) {
+				row_head[r - 1].size.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			// un altro thread ha modificato il collegamento: la ricerca riparte da link,
+			// che resta valido perche' i nodi non vengono mai staccati
+		}
+	}
+
+	/**
+	 Ritorna il valore in (r;c). Puo' essere chiamato da piu' thread, anche
+	 durante gli inserimenti.
+
+	 @param r riga
+	 @param c colonna
+	*/
+	T operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		std::atomic<node*>* link = &row_head[r - 1].head;
+		const node* current = search(link, c);
+		if (current != 0 && current->colonna == c)
+			return current->dato.load(std::memory_order_acquire);
+		return D;
+	}
+
+	/**
+	 Ricostruisce la matrice a lista. Va chiamato a costruzione finita: durante
+	 inserimenti concorrenti vede solo una parte degli elementi.
+
+	 @return la matrice a lista con gli stessi elementi
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> to_matrix() const {
+		SparseMatrix<T, Index> M(righe, colonne, D);
+		std::vector<element> batch;
+		batch.reserve(get_size());
+		const_iterator Ib = begin(), Ie = end();
+		for (; Ib != Ie; ++Ib)
+			batch.push_back(*Ib);
+		M.scatter(batch);
+		return M;
+	}
+
+	/**
+	 Iteratore costante in ordine naturale; gli elementi sono restituiti per valore.
+	 Se la matrice viene modificata durante l'iterazione ogni elemento restituito
+	 e' valido, ma gli inserimenti concorrenti possono non essere visti.
+	*/
+	class const_iterator {
+		const ConcurrentSparseMatrix* m;
+		Index r; ///< riga corrente (0-based)
+		const node* n; ///< nodo corrente
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef element reference;
+
+		const_iterator() : m(0), r(0), n(0) {}
+
+		// Ritorna l'elemento riferito dall'iteratore
+		reference operator*() const {
+			return element(r + 1, n->colonna, n->dato.load(std::memory_order_acquire));
+		}
+
+		// Operatore di iterazione post-incremento
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		const_iterator& operator++() {
+			n = n->next.load(std::memory_order_acquire);
+			settle();
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (n == other.n);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class ConcurrentSparseMatrix;
+
+		// Costruttore privato di inizializzazione usato da begin
+		const_iterator(const ConcurrentSparseMatrix* mm, const Index rr) : m(mm), r(rr), n(0) {
+			if (r < m->righe)
+				n = m->row_head[r].head.load(std::memory_order_acquire);
+			settle();
+		}
+
+		// Se la riga corrente e' finita passa alla prima riga non vuota successiva
+		void settle() {
+			while (n == 0 && r + 1 < m->righe) {
+				++r;
+				n = m->row_head[r].head.load(std::memory_order_acquire);
+			}
+		}
+	}; // classe const_iterator
+
+	/**
+	 Ritorna l'iteratore costante all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	/**
+	 Ritorna l'iteratore costante alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return const_iterator();
+	}
+};
+
+#endif
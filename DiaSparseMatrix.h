@@ -0,0 +1,228 @@
+#ifndef DIA_SPARSE_MATRIX_H
+#define DIA_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ Matrice sparsa a diagonali (formato DIA), adatta alle matrici a banda come
+ quelle dei problemi alle differenze finite. Ogni diagonale occupata e'
+ identificata dal suo offset colonna - riga e memorizzata come un array
+ contiguo di get_righe() valori indicizzato per riga; le caselle della
+ diagonale che non sono elementi valgono il dato di default. Il prodotto
+ matrice-vettore scorre ogni diagonale con accessi contigui sia ai valori sia
+ a x e y, senza indici per elemento, e il compilatore lo puo' vettorizzare.
+ La struttura e' fissa: si costruisce da una SparseMatrix, da cui le diagonali
+ vengono rilevate automaticamente.
+
+ @brief matrice sparsa a diagonali
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class DiaSparseMatrix {
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	size_t size; ///< numero di elementi della matrice di partenza
+	std::vector<int64_t> offsets; ///< offset colonna - riga delle diagonali, crescenti
+	std::vector<T> diag; ///< la diagonale d ha il valore della riga i+1 in diag[d * righe + i]
+
+	/**
+	 Prima riga (0-based) della diagonale con offset off
+	*/
+	size_t first_row(const int64_t off) const {
+		return (off < 0) ? (size_t)(-off) : 0;
+	}
+
+	/**
+	 Fine (0-based, esclusa) delle righe della diagonale con offset off
+	*/
+	size_t last_row(const int64_t off) const {
+		const int64_t fine = (int64_t)colonne - off;
+		return (size_t)std::min<int64_t>((int64_t)righe, fine);
+	}
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+
+	/**
+	 Rileva le diagonali occupate da una SparseMatrix o da una SoASparseMatrix
+
+	 @param M matrice da analizzare
+	 @return gli offset colonna - riga delle diagonali occupate, crescenti
+	*/
+	template <typename Sorgente>
+	static std::vector<int64_t> find_diagonals(const Sorgente& M) {
+		std::vector<int64_t> off;
+		typename Sorgente::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib)
+			off.push_back((int64_t)(*Ib).colonna - (int64_t)(*Ib).riga);
+		std::sort(off.begin(), off.end());
+		off.erase(std::unique(off.begin(), off.end()), off.end());
+		return off;
+	}
+
+	/**
+	 Ritorna true se conviene convertire M: le caselle memorizzate dal formato a
+	 diagonali (elementi piu' riempimento) non superano max_riempimento volte
+	 il numero di elementi
+
+	 @param M matrice da analizzare
+	 @param max_riempimento rapporto massimo tra caselle memorizzate ed elementi
+	*/
+	static bool is_banded(const SparseMatrix<T, Index>& M, const double max_riempimento = 2.0) {
+		if (M.get_size() == 0)
+			return false;
+		const size_t n = find_diagonals(M).size();
+		return (double)n * (double)M.get_righe() <= max_riempimento * (double)M.get_size();
+	}
+
+	/**
+	 Costruttore, copia una SparseMatrix o una SoASparseMatrix rilevandone le
+	 diagonali occupate
+
+	 @param M matrice da copiare
+	 @throw eccezione di allocazione di memoria
+	*/
+	template <typename Sorgente>
+	explicit DiaSparseMatrix(const Sorgente& M) : righe(M.get_righe()), colonne(M.get_colonne()), D(M.get_default()),
+			size(M.get_size()), offsets(find_diagonals(M)) {
+		diag.assign(offsets.size() * (size_t)righe, D);
+		typename Sorgente::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib) {
+			const int64_t off = (int64_t)(*Ib).colonna - (int64_t)(*Ib).riga;
+			const size_t d = std::lower_bound(offsets.begin(), offsets.end(), off) - offsets.begin();
+			diag[d * (size_t)righe + (size_t)((*Ib).riga - 1)] = (*Ib).dato;
+		}
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	size_t get_size() const {
+		return size;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Ritorna gli offset colonna - riga delle diagonali memorizzate
+	*/
+	const std::vector<int64_t>& get_offsets() const {
+		return offsets;
+	}
+
+	/**
+	 Ritorna i byte occupati da diagonali e offset
+	*/
+	size_t memory_bytes() const {
+		return diag.size() * sizeof(T) + offsets.size() * sizeof(int64_t);
+	}
+
+	/**
+	 Ritorna il valore in (r;c), cercando la diagonale tra gli offset
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		const int64_t off = (int64_t)c - (int64_t)r;
+		std::vector<int64_t>::const_iterator p = std::lower_bound(offsets.begin(), offsets.end(), off);
+		if (p != offsets.end() && *p == off)
+			return diag[(size_t)(p - offsets.begin()) * (size_t)righe + (size_t)(r - 1)];
+		return D;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x, una diagonale alla volta. Il riempimento
+	 delle diagonali vale D, quindi la correzione del default conta come
+	 memorizzate tutte le caselle delle diagonali.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const default_correction<T> correzione(D, x, colonne);
+		std::vector<T> somma_diagonali(correzione.active() ? (size_t)righe : 0, zero);
+		for (size_t i = 0; i < (size_t)righe; ++i)
+			y[i] = zero;
+		for (size_t d = 0; d < offsets.size(); ++d) {
+			const int64_t off = offsets[d];
+			const size_t i0 = first_row(off), i1 = last_row(off);
+			const size_t n = i1 - i0;
+			const T* v = diag.data() + d * (size_t)righe + i0;
+			const T* xs = x + (int64_t)i0 + off; // xs[k] == x[i0 + k + off]
+			T* ys = y + i0;
+			for (size_t k = 0; k < n; ++k)
+				ys[k] += v[k] * xs[k];
+			if (correzione.active())
+				for (size_t k = 0; k < n; ++k)
+					somma_diagonali[i0 + k] += xs[k];
+		}
+		if (correzione.active())
+			for (size_t i = 0; i < (size_t)righe; ++i)
+				y[i] = correzione(y[i], somma_diagonali[i]);
+	}
+
+	/**
+	 Ricostruisce la matrice a lista: le caselle delle diagonali che valgono D
+	 non diventano elementi
+
+	 @return la matrice a lista
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> to_matrix() const {
+		SparseMatrix<T, Index> M(righe, colonne, D);
+		std::vector<element> batch;
+		batch.reserve(size);
+		for (size_t d = 0; d < offsets.size(); ++d) {
+			const size_t i0 = first_row(offsets[d]), i1 = last_row(offsets[d]);
+			for (size_t i = i0; i < i1; ++i) {
+				const T& v = diag[d * (size_t)righe + i];
+				if (!(v == D))
+					batch.push_back(element((Index)(i + 1), (Index)((int64_t)i + offsets[d] + 1), v));
+			}
+		}
+		M.scatter(batch);
+		return M;
+	}
+};
+
+/**
+ Prodotto matrice-vettore su una matrice a diagonali
+
+ @param M matrice a diagonali
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename Index>
+void spmv(const DiaSparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
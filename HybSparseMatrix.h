@@ -0,0 +1,240 @@
+#ifndef HYB_SPARSE_MATRIX_H
+#define HYB_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <vector>
+
+/**
+ Matrice sparsa in formato ibrido (HYB): i primi get_ell_width() elementi di
+ ogni riga stanno in una parte ELLPACK, un blocco rettangolare righe x K
+ memorizzato per colonne, e gli elementi in eccesso delle righe piu' lunghe in
+ una parte a coordinate (COO). K viene scelto in modo che almeno un terzo
+ delle righe lo raggiunga: la parte regolare resta compatta anche quando
+ poche righe sono molto piu' lunghe delle altre (distribuzioni a legge di
+ potenza), e quelle righe non gonfiano il riempimento.
+ La struttura e' fissa: si costruisce da una SparseMatrix.
+
+ @brief matrice sparsa ibrida ELLPACK + COO
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class HybSparseMatrix {
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	size_t K; ///< larghezza della parte ELLPACK
+	std::vector<Index> ell_col; ///< colonna dello slot k della riga i+1 in ell_col[k * righe + i], 0 se vuoto
+	std::vector<T> ell_val; ///< valore dello slot, D se vuoto
+	std::vector<Index> coo_row; ///< riga degli elementi in eccesso, in ordine naturale
+	std::vector<Index> coo_col; ///< colonna degli elementi in eccesso
+	std::vector<T> coo_val; ///< valore degli elementi in eccesso
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+
+	/**
+	 Sceglie la larghezza della parte ELLPACK: la massima K tale che almeno un
+	 terzo delle righe abbia K o piu' elementi
+
+	 @param lunghezze numero di elementi di ogni riga
+	*/
+	static size_t ell_width(const std::vector<size_t>& lunghezze) {
+		if (lunghezze.empty())
+			return 0;
+		const size_t max_riga = *std::max_element(lunghezze.begin(), lunghezze.end());
+		std::vector<size_t> almeno(max_riga + 2, 0); // almeno[k] = righe con k o piu' elementi
+		for (size_t i = 0; i < lunghezze.size(); ++i)
+			++almeno[lunghezze[i]];
+		for (size_t k = max_riga; k > 0; --k)
+			almeno[k - 1] += almeno[k];
+		const size_t soglia = std::max<size_t>(1, lunghezze.size() / 3);
+		size_t k = 0;
+		while (k < max_riga && almeno[k + 1] >= soglia)
+			++k;
+		return k;
+	}
+
+	/**
+	 Costruttore, divide gli elementi di una SparseMatrix o di una SoASparseMatrix
+	 tra parte ELLPACK e parte COO
+
+	 @param M matrice da copiare
+	 @throw eccezione di allocazione di memoria
+	*/
+	template <typename Sorgente>
+	explicit HybSparseMatrix(const Sorgente& M) : righe(M.get_righe()), colonne(M.get_colonne()), D(M.get_default()) {
+		std::vector<size_t> lunghezze((size_t)righe, 0);
+		typename Sorgente::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib)
+			++lunghezze[(*Ib).riga - 1];
+		K = ell_width(lunghezze);
+		ell_col.assign(K * (size_t)righe, 0);
+		ell_val.assign(K * (size_t)righe, D);
+		Index riga = 0;
+		size_t k = 0;
+		for (Ib = M.begin(); Ib != Ie; ++Ib) {
+			if ((*Ib).riga != riga) {
+				riga = (*Ib).riga;
+				k = 0;
+			}
+			if (k < K) {
+				ell_col[k * (size_t)righe + (size_t)(riga - 1)] = (*Ib).colonna;
+				ell_val[k * (size_t)righe + (size_t)(riga - 1)] = (*Ib).dato;
+			}
+			else {
+				coo_row.push_back(riga);
+				coo_col.push_back((*Ib).colonna);
+				coo_val.push_back((*Ib).dato);
+			}
+			++k;
+		}
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	size_t get_size() const {
+		size_t n = coo_val.size();
+		for (size_t k = 0; k < ell_col.size(); ++k)
+			if (ell_col[k] != 0)
+				++n;
+		return n;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Ritorna la larghezza della parte ELLPACK
+	*/
+	size_t get_ell_width() const {
+		return K;
+	}
+
+	/**
+	 Ritorna il numero di elementi nella parte COO
+	*/
+	size_t get_coo_size() const {
+		return coo_val.size();
+	}
+
+	/**
+	 Ritorna i byte occupati dalle due parti
+	*/
+	size_t memory_bytes() const {
+		return ell_col.size() * sizeof(Index) + ell_val.size() * sizeof(T)
+			+ (coo_row.size() + coo_col.size()) * sizeof(Index) + coo_val.size() * sizeof(T);
+	}
+
+	/**
+	 Ritorna il valore in (r;c): scansione degli slot ELLPACK della riga, poi
+	 ricerca binaria nella parte COO
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		for (size_t k = 0; k < K; ++k) {
+			const Index col = ell_col[k * (size_t)righe + (size_t)(r - 1)];
+			if (col == c)
+				return ell_val[k * (size_t)righe + (size_t)(r - 1)];
+			if (col == 0 || col > c)
+				return D;
+		}
+		typename std::vector<Index>::const_iterator first = std::lower_bound(coo_row.begin(), coo_row.end(), r);
+		typename std::vector<Index>::const_iterator last = std::upper_bound(first, coo_row.end(), r);
+		typename std::vector<Index>::const_iterator p = std::lower_bound(coo_col.begin() + (first - coo_row.begin()),
+			coo_col.begin() + (last - coo_row.begin()), c);
+		if (p != coo_col.begin() + (last - coo_row.begin()) && *p == c)
+			return coo_val[p - coo_col.begin()];
+		return D;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x: la parte ELLPACK per slot, con accessi
+	 contigui a valori e y, poi la parte COO.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const default_correction<T> correzione(D, x, colonne);
+		std::vector<T> somma_memorizzati(correzione.active() ? (size_t)righe : 0, zero);
+		for (size_t i = 0; i < (size_t)righe; ++i)
+			y[i] = zero;
+		for (size_t k = 0; k < K; ++k) {
+			const Index* c = ell_col.data() + k * (size_t)righe;
+			const T* v = ell_val.data() + k * (size_t)righe;
+			for (size_t i = 0; i < (size_t)righe; ++i)
+				if (c[i] != 0) {
+					y[i] += v[i] * x[c[i] - 1];
+					if (correzione.active())
+						somma_memorizzati[i] += x[c[i] - 1];
+				}
+		}
+		for (size_t k = 0; k < coo_val.size(); ++k) {
+			y[coo_row[k] - 1] += coo_val[k] * x[coo_col[k] - 1];
+			if (correzione.active())
+				somma_memorizzati[coo_row[k] - 1] += x[coo_col[k] - 1];
+		}
+		if (correzione.active())
+			for (size_t i = 0; i < (size_t)righe; ++i)
+				y[i] = correzione(y[i], somma_memorizzati[i]);
+	}
+
+	/**
+	 Ricostruisce la matrice a lista
+
+	 @return la matrice a lista con gli stessi elementi
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> to_matrix() const {
+		SparseMatrix<T, Index> M(righe, colonne, D);
+		std::vector<element> batch;
+		for (size_t k = 0; k < K; ++k)
+			for (size_t i = 0; i < (size_t)righe; ++i)
+				if (ell_col[k * (size_t)righe + i] != 0)
+					batch.push_back(element((Index)(i + 1), ell_col[k * (size_t)righe + i], ell_val[k * (size_t)righe + i]));
+		for (size_t k = 0; k < coo_val.size(); ++k)
+			batch.push_back(element(coo_row[k], coo_col[k], coo_val[k]));
+		M.scatter(batch);
+		return M;
+	}
+};
+
+/**
+ Prodotto matrice-vettore su una matrice ibrida
+
+ @param M matrice ibrida
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename Index>
+void spmv(const HybSparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
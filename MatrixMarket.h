@@ -0,0 +1,442 @@
+#ifndef MATRIX_MARKET_H
+#define MATRIX_MARKET_H
+
+#include "SparseMatrix.h"
+#include "WorkStealing.h"
+
+#include <charconv>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ Parser del formato Matrix Market (.mtx) in coordinate. Legge l'intestazione
+ (campo integer, real o pattern; simmetria general, symmetric o skew-symmetric),
+ poi analizza le righe di dati con std::from_chars e le consegna a blocchi a
+ SparseMatrix::scatter, che le fonde nella lista con una sola scansione.
+ Gli indici del file sono 1-based come riga e colonna di SparseMatrix, quindi
+ non serve alcuna conversione. Lo stesso parser legge anche file di triplette
+ "riga colonna valore" senza intestazione (separate da spazi o virgole, come nei CSV).
+ Le virgole sono accettate solo nelle triplette: in un file .mtx, come un testo
+ in eccesso dopo i campi di una riga, sono un errore di formato.
+
+ @brief lettore di file Matrix Market
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class MatrixMarketParser {
+public:
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento prodotto dal parser
+
+	/**
+	 Tipo dei valori dichiarato nell'intestazione
+	*/
+	enum field_type {
+		integer_field, ///< valori interi
+		real_field, ///< valori reali
+		pattern_field ///< nessun valore, ogni elemento presente vale 1
+	};
+
+	/**
+	 Simmetria dichiarata nell'intestazione
+	*/
+	enum symmetry_type {
+		general, ///< tutti gli elementi sono nel file
+		symmetric, ///< solo un triangolo, (j;i) vale come (i;j)
+		skew_symmetric ///< solo un triangolo, (j;i) vale come -(i;j)
+	};
+
+private:
+	Index righe; ///< righe dichiarate
+	Index colonne; ///< colonne dichiarate
+	size_t nnz; ///< numero di righe di dati dichiarate
+	field_type field; ///< tipo dei valori
+	symmetry_type symmetry; ///< simmetria
+	bool intestazione; ///< true se il file ha l'intestazione Matrix Market (e quindi nnz e' noto)
+
+	/**
+	 Salta spazi e tabulazioni, e anche le virgole se il file e' di triplette
+	*/
+	const char* skip_blanks(const char* p, const char* end) const {
+		while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || (*p == ',' && !intestazione)))
+			++p;
+		return p;
+	}
+
+	/**
+	 Verifica che dopo i campi letti la riga non contenga altro
+
+	 @param p posizione corrente, avanzata fino all'a capo
+	 @param end fine del buffer
+	 @throw std::runtime_error se ci sono caratteri in eccesso
+	*/
+	void expect_line_end(const char*& p, const char* end) const {
+		p = skip_blanks(p, end);
+		if (p != end && *p != '\n')
+			throw std::runtime_error("MatrixMarket: testo in eccesso a fine riga");
+	}
+
+	/**
+	 Legge un numero con std::from_chars
+
+	 @param p posizione corrente, avanzata oltre il numero
+	 @param end fine del buffer
+	 @param out numero letto
+	 @throw std::runtime_error se il testo non e' un numero
+	*/
+	template <typename N>
+	void parse_number(const char*& p, const char* end, N& out) const {
+		p = skip_blanks(p, end);
+		std::from_chars_result res = std::from_chars(p, end, out);
+		if (res.ec != std::errc())
+			throw std::runtime_error("MatrixMarket: numero non valido");
+		p = res.ptr;
+	}
+
+	/**
+	 Legge un indice decimale senza segno. Piu' veloce di std::from_chars per
+	 gli indici, che sono la maggior parte del testo.
+
+	 @param p posizione corrente, avanzata oltre l'indice
+	 @param end fine del buffer
+	 @return l'indice letto
+	 @throw std::runtime_error se il testo non e' un indice
+	*/
+	Index parse_index(const char*& p, const char* end) const {
+		p = skip_blanks(p, end);
+		const char* start = p;
+		const unsigned long long max = (unsigned long long)std::numeric_limits<Index>::max();
+		unsigned long long x = 0;
+		while (p != end && (unsigned)(*p - '0') < 10u) {
+			const unsigned d = (unsigned)(*p - '0');
+			if (x > (max - d) / 10)
+				throw std::runtime_error("MatrixMarket: indice troppo grande per Index");
+			x = x * 10 + d;
+			++p;
+		}
+		if (p == start)
+			throw std::runtime_error("MatrixMarket: indice non valido");
+		return (Index)x;
+	}
+
+	/**
+	 Porta tutta la stringa in minuscolo (le parole chiave non distinguono maiuscole)
+	*/
+	static std::string lower(std::string s) {
+		for (size_t i = 0; i < s.size(); ++i)
+			s[i] = (char)std::tolower((unsigned char)s[i]);
+		return s;
+	}
+
+public:
+	/**
+	 Costruttore, legge intestazione, commenti e riga delle dimensioni dallo stream
+
+	 @param is stream posizionato all'inizio del file
+	 @throw std::runtime_error se l'intestazione non e' supportata o la riga delle dimensioni e' malformata
+	*/
+	explicit MatrixMarketParser(std::istream& is) : righe(0), colonne(0), nnz(0), field(real_field), symmetry(general), intestazione(true) {
+		std::string banner, object, format, f, sym;
+		if (!(is >> banner >> object >> format >> f >> sym) || banner != "%%MatrixMarket")
+			throw std::runtime_error("MatrixMarket: intestazione mancante");
+		if (lower(object) != "matrix" || lower(format) != "coordinate")
+			throw std::runtime_error("MatrixMarket: sono supportate solo matrici in coordinate");
+		f = lower(f);
+		sym = lower(sym);
+		if (f == "integer")
+			field = integer_field;
+		else if (f == "real" || f == "double")
+			field = real_field;
+		else if (f == "pattern")
+			field = pattern_field;
+		else
+			throw std::runtime_error("MatrixMarket: campo non supportato " + f);
+		if (sym == "general")
+			symmetry = general;
+		else if (sym == "symmetric")
+			symmetry = symmetric;
+		else if (sym == "skew-symmetric")
+			symmetry = skew_symmetric;
+		else
+			throw std::runtime_error("MatrixMarket: simmetria non supportata " + sym);
+		std::string line;
+		std::getline(is, line); // resto della riga di intestazione
+		while (std::getline(is, line)) {
+			const char* p = skip_blanks(line.data(), line.data() + line.size());
+			if (p == line.data() + line.size() || *p == '%')
+				continue;
+			const char* end = line.data() + line.size();
+			parse_number(p, end, righe);
+			parse_number(p, end, colonne);
+			parse_number(p, end, nnz);
+			expect_line_end(p, end);
+			if (righe <= 0 || colonne <= 0)
+				throw std::runtime_error("MatrixMarket: dimensioni non valide");
+			return;
+		}
+		throw std::runtime_error("MatrixMarket: riga delle dimensioni mancante");
+	}
+
+	/**
+	 Costruttore per file di triplette senza intestazione, di cui le dimensioni
+	 sono note a priori. I valori sono letti come reali.
+
+	 @param r numero di righe
+	 @param c numero di colonne
+	*/
+	MatrixMarketParser(const Index r, const Index c) : righe(r), colonne(c), nnz(0), field(real_field), symmetry(general), intestazione(false) {
+		assert(r > 0);
+		assert(c > 0);
+	}
+
+	/**
+	 Getter per le righe dichiarate
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne dichiarate
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il numero di righe di dati dichiarate
+	*/
+	size_t get_nnz() const {
+		return nnz;
+	}
+
+	/**
+	 Analizza le righe di dati contenute in [begin;end), che deve terminare a fine riga
+	 (o a fine file), e accoda gli elementi in out. Per le matrici simmetriche accoda
+	 anche l'elemento speculare fuori diagonale.
+
+	 @param begin inizio del testo
+	 @param end fine del testo
+	 @param out elementi letti
+	 @return numero di righe di dati lette
+	 @throw std::runtime_error se una riga e' malformata, ha testo in eccesso o e' fuori dalla matrice
+	*/
+	size_t parse_lines(const char* begin, const char* end, std::vector<element>& out) const {
+		size_t lette = 0;
+		const char* p = begin;
+		while (p != end) {
+			p = skip_blanks(p, end);
+			if (p != end && *p != '\n' && *p != '%') {
+				const Index r = parse_index(p, end);
+				const Index c = parse_index(p, end);
+				if (r <= 0 || r > righe || c <= 0 || c > colonne)
+					throw std::runtime_error("MatrixMarket: indice fuori dalla matrice");
+				T v = T(1);
+				if (field == integer_field) {
+					long long x;
+					parse_number(p, end, x);
+					v = (T)x;
+				}
+				else if (field == real_field) {
+					double x;
+					parse_number(p, end, x);
+					v = (T)x;
+				}
+				expect_line_end(p, end);
+				out.push_back(element(r, c, v));
+				if (symmetry != general && r != c)
+					out.push_back(element(c, r, symmetry == symmetric ? v : (T)-v));
+				++lette;
+			}
+			const char* nl = (const char*)std::memchr(p, '\n', end - p);
+			p = (nl == 0) ? end : nl + 1;
+		}
+		return lette;
+	}
+
+	/**
+	 Analizza [begin;end) dividendolo in threads pezzi allineati agli a capo, ognuno
+	 analizzato nel proprio buffer di elementi da un compito di parallel_for (sui
+	 thread del pool, senza crearne di nuovi). I buffer vengono poi concatenati in
+	 out nell'ordine del testo, cosi' le caselle ripetute mantengono l'ordine del
+	 file; anche gli errori vengono rilanciati nell'ordine del testo.
+
+	 @param begin inizio del testo
+	 @param end fine del testo, a fine riga
+	 @param out elementi letti
+	 @param threads numero di thread
+	 @return numero di righe di dati lette
+	 @throw std::runtime_error se una riga e' malformata, la prima nell'ordine del testo
+	*/
+	size_t parse_parallel(const char* begin, const char* end, std::vector<element>& out, const unsigned threads) const {
+		if (threads <= 1)
+			return parse_lines(begin, end, out);
+		std::vector<const char*> tagli(threads + 1);
+		tagli[0] = begin;
+		tagli[threads] = end;
+		for (unsigned t = 1; t < threads; ++t) {
+			const char* p = begin + (end - begin) * t / threads;
+			if (p < tagli[t - 1])
+				p = tagli[t - 1];
+			const char* nl = (const char*)std::memchr(p, '\n', end - p);
+			tagli[t] = (nl == 0) ? end : nl + 1;
+		}
+		std::vector<std::vector<element> > parti(threads);
+		std::vector<size_t> lette(threads, 0);
+		std::vector<std::exception_ptr> errori(threads);
+		parallel_for(threads, [&](const size_t t) {
+			try {
+				lette[t] = parse_lines(tagli[t], tagli[t + 1], parti[t]);
+			}
+			catch (...) {
+				errori[t] = std::current_exception(); // rilanciata sotto, nell'ordine dei pezzi
+			}
+		}, threads);
+		size_t totale = 0;
+		size_t elementi = out.size();
+		for (unsigned t = 0; t < threads; ++t) {
+			if (errori[t])
+				std::rethrow_exception(errori[t]);
+			totale += lette[t];
+			elementi += parti[t].size();
+		}
+		out.reserve(elementi);
+		for (unsigned t = 0; t < threads; ++t) // element non e' assegnabile, copio un elemento alla volta
+			for (size_t k = 0; k < parti[t].size(); ++k)
+				out.push_back(parti[t][k]);
+		return totale;
+	}
+
+	/**
+	 Legge tutte le righe di dati dallo stream a blocchi di dimensione fissa e le
+	 fonde in M con scatter, cosi' il file non viene mai caricato per intero.
+	 Ogni blocco e' analizzato in parallelo da threads thread.
+
+	 @param is stream posizionato dopo la riga delle dimensioni
+	 @param M matrice di destinazione
+	 @param threads numero di thread, 0 per usarne uno per core
+	 @throw std::runtime_error se il file e' malformato o troncato
+	*/
+	void read_into(std::istream& is, SparseMatrix<T, Index>& M, unsigned threads = 0) const {
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		const size_t block = (size_t)threads << 22;
+		std::vector<char> buf;
+		std::vector<element> batch;
+		size_t carry = 0;
+		size_t lette = 0;
+		while (is) {
+			buf.resize(carry + block);
+			is.read(&buf[carry], block);
+			const size_t len = carry + (size_t)is.gcount();
+			size_t taglio = len;
+			if (is) { // mi fermo all'ultimo a capo, il resto passa al blocco successivo
+				while (taglio > 0 && buf[taglio - 1] != '\n')
+					--taglio;
+			}
+			lette += parse_parallel(buf.data(), buf.data() + taglio, batch, threads);
+			M.scatter(batch);
+			batch.clear();
+			carry = len - taglio;
+			std::memmove(buf.data(), buf.data() + taglio, carry);
+		}
+		if (intestazione && lette != nnz)
+			throw std::runtime_error("MatrixMarket: numero di elementi diverso da quello dichiarato");
+	}
+};
+
+/**
+ Legge una matrice in formato Matrix Market da uno stream.
+ Il dato di default della matrice e' T() (lo zero implicito del formato).
+
+ @param is stream da leggere
+ @param threads numero di thread per l'analisi, 0 per usarne uno per core
+ @return la matrice letta
+ @throw std::runtime_error se il file e' malformato, eccezione di allocazione di memoria
+*/
+template <typename T, typename Index = int>
+SparseMatrix<T, Index> read_mtx(std::istream& is, const unsigned threads = 0) {
+	MatrixMarketParser<T, Index> parser(is);
+	SparseMatrix<T, Index> M(parser.get_righe(), parser.get_colonne(), T());
+	parser.read_into(is, M, threads);
+	return M;
+}
+
+/**
+ Legge una matrice in formato Matrix Market da file.
+
+ @param filename percorso del file
+ @param threads numero di thread per l'analisi, 0 per usarne uno per core
+ @return la matrice letta
+ @throw std::runtime_error se il file non si apre o e' malformato
+*/
+template <typename T, typename Index = int>
+SparseMatrix<T, Index> read_mtx(const char* filename, const unsigned threads = 0) {
+	std::ifstream is(filename, std::ios::binary);
+	if (!is)
+		throw std::runtime_error(std::string("MatrixMarket: impossibile aprire ") + filename);
+	return read_mtx<T, Index>(is, threads);
+}
+
+/**
+ Legge una matrice r x c da un file di triplette "riga,colonna,valore" (CSV o
+ separate da spazi), con indici 1-based e senza intestazione.
+ Il dato di default della matrice e' T().
+
+ @param is stream da leggere
+ @param r numero di righe
+ @param c numero di colonne
+ @param threads numero di thread per l'analisi, 0 per usarne uno per core
+ @return la matrice letta
+ @throw std::runtime_error se il file e' malformato, eccezione di allocazione di memoria
+*/
+template <typename T, typename Index = int>
+SparseMatrix<T, Index> read_triplets(std::istream& is, const Index r, const Index c, const unsigned threads = 0) {
+	MatrixMarketParser<T, Index> parser(r, c);
+	SparseMatrix<T, Index> M(r, c, T());
+	parser.read_into(is, M, threads);
+	return M;
+}
+
+/**
+ Scrive una matrice in formato Matrix Market (coordinate general) su uno stream.
+ Il campo e' integer per i tipi interi e real per gli altri. Il dato di default
+ non viene salvato: il formato prevede sempre lo zero implicito.
+
+ @param os stream di destinazione
+ @param M matrice da scrivere
+*/
+template <typename T, typename Index>
+void write_mtx(std::ostream& os, const SparseMatrix<T, Index>& M) {
+	os << "%%MatrixMarket matrix coordinate " << (std::numeric_limits<T>::is_integer ? "integer" : "real") << " general\n";
+	os << M.get_righe() << " " << M.get_colonne() << " " << M.get_size() << "\n";
+	const std::streamsize precision = os.precision(std::numeric_limits<T>::max_digits10);
+	typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+	for (; Ib != Ie; ++Ib)
+		os << (*Ib).riga << " " << (*Ib).colonna << " " << (*Ib).dato << "\n";
+	os.precision(precision);
+}
+
+/**
+ Scrive una matrice in formato Matrix Market su file.
+
+ @param filename percorso del file
+ @param M matrice da scrivere
+ @throw std::runtime_error se il file non si apre
+*/
+template <typename T, typename Index>
+void write_mtx(const char* filename, const SparseMatrix<T, Index>& M) {
+	std::ofstream os(filename, std::ios::binary);
+	if (!os)
+		throw std::runtime_error(std::string("MatrixMarket: impossibile aprire ") + filename);
+	write_mtx(os, M);
+}
+
+#endif
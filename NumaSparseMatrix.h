@@ -0,0 +1,265 @@
+#ifndef NUMA_SPARSE_MATRIX_H
+#define NUMA_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+#include "WorkStealing.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(SPARSEMATRIX_NUMA) && defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+/**
+ Matrice sparsa a righe compresse divisa in partizioni di righe consecutive,
+ bilanciate sul numero di elementi, pensata per macchine NUMA. Ogni partizione
+ ha i propri array, allocati e scritti per la prima volta dal thread che poi
+ la elaborera' nel prodotto matrice-vettore: con la politica "first touch" del
+ sistema operativo le sue pagine finiscono sul nodo di memoria di quel thread.
+ La matrice ha un proprio pool persistente con un thread per partizione: la
+ partizione p viene costruita e poi elaborata sempre dallo stesso thread.
+ Compilando con SPARSEMATRIX_NUMA (solo Linux) ogni thread viene fissato una
+ volta per tutte alla CPU della sua partizione, cosi' ogni partizione viene
+ letta solo da memoria locale. Senza SPARSEMATRIX_NUMA i thread non sono
+ fissati e la matrice resta una normale matrice parallela.
+ La struttura e' fissa: si costruisce da una SparseMatrix. Non e' copiabile,
+ perche' una copia avrebbe le pagine sul nodo del thread che la copia.
+
+ @brief matrice sparsa a partizioni con allocazione locale al thread
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class NumaSparseMatrix {
+	/**
+	 Righe [r0;r1) (0-based) con i loro elementi
+	*/
+	struct partition {
+		Index r0; ///< prima riga
+		Index r1; ///< riga dopo l'ultima
+		unsigned cpu; ///< CPU a cui e' legata la partizione
+		std::vector<size_t> row_ptr; ///< la riga r0+i ha gli elementi in [row_ptr[i];row_ptr[i+1])
+		std::vector<Index> col; ///< colonne degli elementi
+		std::vector<T> val; ///< valori degli elementi
+	};
+
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	size_t size; ///< numero di elementi
+	std::vector<partition> parti; ///< partizioni in ordine di riga
+	std::unique_ptr<work_pool> pool; ///< un thread per partizione, il worker p elabora la partizione p
+
+	NumaSparseMatrix(const NumaSparseMatrix&); // non copiabile
+	NumaSparseMatrix& operator=(const NumaSparseMatrix&);
+
+	/**
+	 Ritorna true se la partizione q finisce prima della riga r (1-based), per lower_bound
+	*/
+	static bool partition_ends_before(const partition& q, const Index r) {
+		return q.r1 < r;
+	}
+
+	/**
+	 Ritorna le CPU su cui il processo puo' girare, in ordine
+	*/
+	static std::vector<unsigned> cpus() {
+		std::vector<unsigned> res;
+#if defined(SPARSEMATRIX_NUMA) && defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+			for (unsigned c = 0; c < CPU_SETSIZE; ++c)
+				if (CPU_ISSET(c, &set))
+					res.push_back(c);
+#endif
+		if (res.empty())
+			for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c)
+				res.push_back(c);
+		return res;
+	}
+
+	/**
+	 Fissa il thread chiamante alla CPU cpu (solo con SPARSEMATRIX_NUMA su Linux)
+	*/
+	static void pin(const unsigned cpu) {
+#if defined(SPARSEMATRIX_NUMA) && defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+		(void)cpu;
+#endif
+	}
+
+	/**
+	 Esegue f(p) per ogni partizione p, sul thread del pool fissato alla sua CPU
+
+	 @param f funtore chiamato con l'indice della partizione
+	 @throw la prima eccezione lanciata da f, dopo che tutti i thread hanno finito
+	*/
+	template <typename F>
+	void on_partitions(F f) const {
+		pool->run_each(f);
+	}
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+
+	/**
+	 Costruttore: divide le righe in partizioni con circa lo stesso numero di
+	 elementi e fa copiare a ogni thread la propria partizione, leggendo la
+	 matrice tramite viste (che non toccano il finger, quindi in parallelo)
+
+	 @param M matrice da copiare
+	 @param n numero di partizioni, 0 per una per CPU disponibile
+	 @throw eccezione di allocazione di memoria
+	*/
+	explicit NumaSparseMatrix(const SparseMatrix<T, Index>& M, size_t n = 0) : righe(M.get_righe()), colonne(M.get_colonne()),
+			D(M.get_default()), size(M.get_size()) {
+		const std::vector<unsigned> lista = cpus();
+		if (n == 0)
+			n = lista.size();
+		n = std::min(n, (size_t)righe);
+		std::vector<size_t> lunghezze((size_t)righe, 0);
+		typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib)
+			++lunghezze[(*Ib).riga - 1];
+		parti.resize(n);
+		size_t r = 0, contati = 0;
+		for (size_t p = 0; p < n; ++p) {
+			const size_t obiettivo = size * (p + 1) / n;
+			parti[p].r0 = (Index)r;
+			// ogni partizione prende almeno una riga e ne lascia almeno una a ciascuna delle successive
+			while (r < (size_t)righe - (n - p - 1) && (r == (size_t)parti[p].r0 || contati + lunghezze[r] <= obiettivo || p + 1 == n))
+				contati += lunghezze[r++];
+			parti[p].r1 = (Index)r;
+			parti[p].cpu = lista[p % lista.size()];
+		}
+		pool.reset(new work_pool((unsigned)n));
+		on_partitions([this](const size_t p) {
+			pin(parti[p].cpu);
+		});
+		on_partitions([&](const size_t p) {
+			partition& q = parti[p];
+			q.row_ptr.assign((size_t)(q.r1 - q.r0) + 1, 0);
+			typename SparseMatrix<T, Index>::const_view v = M.rows_view(q.r0 + 1, q.r1);
+			for (typename SparseMatrix<T, Index>::const_view::iterator Vb = v.begin(), Ve = v.end(); Vb != Ve; ++Vb) {
+				q.col.push_back((*Vb).colonna);
+				q.val.push_back((*Vb).dato);
+				++q.row_ptr[(size_t)((*Vb).riga - q.r0)];
+			}
+			for (size_t i = 1; i < q.row_ptr.size(); ++i)
+				q.row_ptr[i] += q.row_ptr[i - 1];
+		});
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	size_t get_size() const {
+		return size;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Ritorna il numero di partizioni
+	*/
+	size_t get_partitions() const {
+		return parti.size();
+	}
+
+	/**
+	 Ritorna le righe [r0;r1) (0-based) della partizione p
+
+	 @param p partizione
+	*/
+	std::pair<Index, Index> partition_rows(const size_t p) const {
+		return std::make_pair(parti[p].r0, parti[p].r1);
+	}
+
+	/**
+	 Ritorna il valore in (r;c): una ricerca binaria trova la partizione della
+	 riga r, una seconda la colonna nella riga, O(log partizioni + log elementi della riga)
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		// prima partizione con r1 >= r, cioe' che contiene la riga r - 1 (0-based)
+		const partition& q = *std::lower_bound(parti.begin(), parti.end(), r, partition_ends_before);
+		const Index* first = q.col.data() + q.row_ptr[r - 1 - q.r0];
+		const Index* last = q.col.data() + q.row_ptr[r - q.r0];
+		const Index* k = std::lower_bound(first, last, c);
+		if (k != last && *k == c)
+			return q.val[k - q.col.data()];
+		return D;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x: ogni partizione viene elaborata dal suo
+	 thread, sulla CPU che l'ha allocata, e scrive solo le proprie righe di y.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const default_correction<T> correzione(D, x, colonne);
+		on_partitions([&](const size_t p) {
+			const partition& q = parti[p];
+			const Index* c = q.col.data();
+			const T* v = q.val.data();
+			for (size_t i = 0; i < (size_t)(q.r1 - q.r0); ++i) {
+				T acc = zero;
+				T somma_memorizzati = zero;
+				for (size_t k = q.row_ptr[i]; k < q.row_ptr[i + 1]; ++k)
+					acc += v[k] * x[c[k] - 1];
+				if (correzione.active())
+					for (size_t k = q.row_ptr[i]; k < q.row_ptr[i + 1]; ++k)
+						somma_memorizzati += x[c[k] - 1];
+				y[q.r0 + i] = correzione(acc, somma_memorizzati);
+			}
+		});
+	}
+};
+
+/**
+ Prodotto matrice-vettore su una matrice a partizioni
+
+ @param M matrice a partizioni
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename Index>
+void spmv(const NumaSparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
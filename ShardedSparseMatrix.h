@@ -0,0 +1,247 @@
+#ifndef SHARDED_SPARSE_MATRIX_H
+#define SHARDED_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ Matrice sparsa divisa per righe in N blocchi (shard) consecutivi, ognuno con
+ la propria SparseMatrix e il proprio mutex. add e operator() bloccano solo il
+ blocco della riga, quindi thread che lavorano su intervalli di righe diversi
+ non si contendono mai il lock. Anche operator() prende il lock, perche' puo'
+ incontrare un add concorrente sullo stesso blocco.
+ L'iterazione scorre i blocchi in ordine e quindi tutta la matrice in ordine
+ naturale; non prende i lock e va fatta quando non ci sono scritture in corso.
+
+ @brief matrice sparsa divisa per righe con un lock per blocco
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class ShardedSparseMatrix {
+	/**
+	 Un blocco di righe consecutive
+	*/
+	struct shard {
+		std::mutex lock; ///< protegge m
+		SparseMatrix<T, Index> m; ///< righe del blocco, numerate da 1
+
+		shard(const Index r, const Index c, const T& d) : m(r, c, d) {}
+	};
+
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	Index per_shard; ///< righe per blocco (l'ultimo puo' averne meno)
+	std::vector<std::unique_ptr<shard> > shards; ///< blocchi in ordine di riga
+
+	ShardedSparseMatrix(const ShardedSparseMatrix&); // non copiabile
+	ShardedSparseMatrix& operator=(const ShardedSparseMatrix&);
+
+	/**
+	 Indice del blocco che contiene la riga r
+	*/
+	size_t shard_of(const Index r) const {
+		return (size_t)((r - 1) / per_shard);
+	}
+
+	/**
+	 Prima riga (globale) del blocco s, meno uno
+	*/
+	Index offset_of(const size_t s) const {
+		return (Index)(s * (size_t)per_shard);
+	}
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+
+	/**
+	 Costruttore di una matrice vuota
+
+	 @param r numero di righe
+	 @param c numero di colonne
+	 @param d dato di default
+	 @param n numero di blocchi, al massimo r
+	 @throw eccezione di allocazione di memoria
+	*/
+	ShardedSparseMatrix(const Index r, const Index c, const T& d, const size_t n) : righe(r), colonne(c), D(d) {
+		assert(r > 0);
+		assert(n > 0);
+		per_shard = (Index)(((size_t)r + n - 1) / n);
+		Index primo = 0;
+		while (primo < r) {
+			const Index k = std::min<Index>(per_shard, r - primo);
+			shards.push_back(std::unique_ptr<shard>(new shard(k, c, d)));
+			primo += k;
+		}
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	size_t get_size() const {
+		size_t n = 0;
+		for (size_t s = 0; s < shards.size(); ++s) {
+			std::lock_guard<std::mutex> guard(shards[s]->lock);
+			n += shards[s]->m.get_size();
+		}
+		return n;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Ritorna il numero di blocchi
+	*/
+	size_t get_shards() const {
+		return shards.size();
+	}
+
+	/**
+	 Inserisce il valore in (r;c), bloccando solo il blocco della riga r
+
+	 @param r riga
+	 @param c colonna
+	 @param dato valore da inserire
+	 @throw eccezione di allocazione di memoria
+	*/
+	void add(const Index r, const Index c, const T& dato) {
+		assert(r <= righe && r > 0);
+		const size_t s = shard_of(r);
+		std::lock_guard<std::mutex> guard(shards[s]->lock);
+		shards[s]->m.add(r - offset_of(s), c, dato);
+	}
+
+	/**
+	 Ritorna il valore in (r;c), bloccando solo il blocco della riga r
+
+	 @param r riga
+	 @param c colonna
+	*/
+	T operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		const size_t s = shard_of(r);
+		std::lock_guard<std::mutex> guard(shards[s]->lock);
+		return shards[s]->m(r - offset_of(s), c);
+	}
+
+	/**
+	 Ricostruisce la matrice a lista, da chiamare senza scritture in corso
+
+	 @return la matrice a lista con gli stessi elementi
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> to_matrix() const {
+		SparseMatrix<T, Index> M(righe, colonne, D);
+		std::vector<element> batch;
+		const_iterator Ib = begin(), Ie = end();
+		for (; Ib != Ie; ++Ib)
+			batch.push_back(*Ib);
+		M.scatter(batch);
+		return M;
+	}
+
+	/**
+	 Iteratore costante in ordine naturale su tutti i blocchi; gli elementi sono
+	 restituiti per valore, con la riga globale
+	*/
+	class const_iterator {
+		const ShardedSparseMatrix* m;
+		size_t s; ///< blocco corrente
+		typename SparseMatrix<T, Index>::const_iterator it; ///< posizione nel blocco
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef element reference;
+
+		const_iterator() : m(0), s(0) {}
+
+		// Ritorna l'elemento riferito dall'iteratore
+		reference operator*() const {
+			return element((*it).riga + m->offset_of(s), (*it).colonna, (*it).dato);
+		}
+
+		// Operatore di iterazione post-incremento
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		const_iterator& operator++() {
+			++it;
+			settle();
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (s == other.s && it == other.it);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class ShardedSparseMatrix;
+
+		// Costruttore privato di inizializzazione usato da begin e end
+		const_iterator(const ShardedSparseMatrix* mm, const size_t ss) : m(mm), s(ss) {
+			if (s < m->shards.size())
+				it = m->shards[s]->m.begin();
+			settle();
+		}
+
+		// Se il blocco corrente e' finito passa al primo blocco non vuoto successivo
+		void settle() {
+			while (s < m->shards.size() && it == m->shards[s]->m.end()) {
+				++s;
+				if (s < m->shards.size())
+					it = m->shards[s]->m.begin();
+			}
+		}
+	}; // classe const_iterator
+
+	/**
+	 Ritorna l'iteratore costante all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	/**
+	 Ritorna l'iteratore costante alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return const_iterator(this, shards.size());
+	}
+};
+
+#endif
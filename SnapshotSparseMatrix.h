@@ -0,0 +1,559 @@
+#ifndef SNAPSHOT_SPARSE_MATRIX_H
+#define SNAPSHOT_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+
+/**
+ Matrice con un solo scrittore e molti lettori concorrenti, in stile RCU.
+ Lo scrittore modifica una bozza privata (una SparseMatrix) e con publish() ne
+ rende visibile una nuova versione immutabile, pubblicando con una store release
+ il puntatore alla versione. Le versioni condividono le righe non modificate:
+ una versione e' una directory di blocchi di block_rows righe, e publish() copia
+ solo la directory (O(righe / block_rows)), i blocchi che contengono righe
+ modificate e le righe modificate stesse, non tutta la matrice.
+
+ I lettori non prendono lock e non scrivono memoria condivisa: ognuno si
+ registra una volta con un reader, che occupa uno slot in una cache line
+ propria. Per leggere un snapshot il lettore annuncia nel suo slot l'epoca
+ globale corrente e poi legge il puntatore alla versione con una load acquire;
+ le letture dentro lo snapshot sono normali letture di memoria immutabile.
+ Le righe, i blocchi e le directory sostituiti da publish() vengono liberati
+ (reclamazione differita per epoche) solo quando nessuno slot annuncia piu'
+ un'epoca in cui potevano essere visibili; finche' un lettore tiene uno
+ snapshot aperto la memoria delle versioni vecchie resta allocata.
+
+ @brief matrice a versioni con lettori concorrenti senza lock e un solo scrittore
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class SnapshotSparseMatrix {
+public:
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+	typedef typename SparseMatrix<T, Index>::merge_policy merge_policy; ///< politica di fusione di scatter
+
+	static const size_t block_rows = 64; ///< righe per blocco della directory di una versione
+
+private:
+	/**
+	 Riga immutabile di una versione, con colonne crescenti
+	*/
+	struct row {
+		std::vector<Index> cols; ///< colonne degli elementi
+		std::vector<T> vals; ///< valori degli elementi
+	};
+
+	/**
+	 Blocco immutabile di block_rows righe; 0 per una riga vuota
+	*/
+	struct block {
+		const row* righe[block_rows]; ///< righe del blocco
+
+		block() {
+			std::fill(righe, righe + block_rows, (const row*)0);
+		}
+	};
+
+	/**
+	 Slot di un lettore, in una cache line propria per non condividerla con gli altri lettori
+	*/
+	struct alignas(64) reader_slot {
+		std::atomic<uint64_t> epoca; ///< epoca annunciata dal lettore, 0 se non sta leggendo
+		std::atomic<bool> occupato; ///< true se lo slot e' assegnato a un reader
+
+		reader_slot() : epoca(0), occupato(false) {}
+	};
+
+public:
+	/**
+	 Versione pubblicata, immutabile. Le righe non modificate sono condivise con
+	 le versioni precedenti e successive.
+
+	 @brief versione letta dai lettori
+	*/
+	class version {
+		Index righe; ///< numero di righe
+		Index colonne; ///< numero di colonne
+		T D; ///< dato di default
+		size_t size; ///< numero di elementi
+		uint64_t numero; ///< numero della versione
+		std::vector<const block*> blocchi; ///< directory dei blocchi, 0 per un blocco di righe vuote
+
+		friend class SnapshotSparseMatrix;
+
+		version(const Index r, const Index c, const T& d) : righe(r), colonne(c), D(d), size(0), numero(0),
+				blocchi(((size_t)r + block_rows - 1) / block_rows, (const block*)0) {}
+
+		/**
+		 Ritorna la riga r, 0 se e' vuota
+		*/
+		const row* get_row(const Index r) const {
+			const block* b = blocchi[(size_t)(r - 1) / block_rows];
+			return (b == 0) ? 0 : b->righe[(size_t)(r - 1) % block_rows];
+		}
+
+	public:
+		/**
+		 Ritorna il numero di elementi memorizzati
+		*/
+		size_t get_size() const {
+			return size;
+		}
+
+		/**
+		 Getter per le righe
+		*/
+		Index get_righe() const {
+			return righe;
+		}
+
+		/**
+		 Getter per le colonne
+		*/
+		Index get_colonne() const {
+			return colonne;
+		}
+
+		/**
+		 Getter per il dato di default
+		*/
+		const T& get_default() const {
+			return D;
+		}
+
+		/**
+		 Ritorna il numero della versione
+		*/
+		uint64_t get_number() const {
+			return numero;
+		}
+
+		/**
+		 Ritorna il valore in (r;c), con una ricerca binaria nella riga r
+
+		 @param r riga
+		 @param c colonna
+		*/
+		const T& operator()(const Index r, const Index c) const {
+			assert(r <= righe && r > 0);
+			assert(c <= colonne && c > 0);
+			const row* w = get_row(r);
+			if (w == 0)
+				return D;
+			typename std::vector<Index>::const_iterator p = std::lower_bound(w->cols.begin(), w->cols.end(), c);
+			if (p != w->cols.end() && *p == c)
+				return w->vals[p - w->cols.begin()];
+			return D;
+		}
+
+		/**
+		 Prodotto matrice-vettore y = M * x sulla versione, una riga alla volta
+
+		 @param x vettore di get_colonne() elementi
+		 @param y vettore di get_righe() elementi
+		*/
+		void spmv(const T* x, T* y) const {
+			const T zero = T();
+			const default_correction<T> correzione(D, x, colonne);
+			for (Index i = 1; i <= righe; ++i) {
+				T acc = zero;
+				T somma_memorizzati = zero;
+				const row* w = get_row(i);
+				if (w != 0) {
+					for (size_t k = 0; k < w->cols.size(); ++k) {
+						acc += w->vals[k] * x[w->cols[k] - 1];
+						if (correzione.active())
+							somma_memorizzati += x[w->cols[k] - 1];
+					}
+				}
+				y[i - 1] = correzione(acc, somma_memorizzati);
+			}
+		}
+
+		/**
+		 Ricostruisce la matrice a lista
+
+		 @return la matrice a lista con gli stessi elementi
+		 @throw eccezione di allocazione di memoria
+		*/
+		SparseMatrix<T, Index> to_matrix() const {
+			SparseMatrix<T, Index> M(righe, colonne, D);
+			std::vector<element> batch;
+			batch.reserve(size);
+			for (Index i = 1; i <= righe; ++i) {
+				const row* w = get_row(i);
+				if (w != 0)
+					for (size_t k = 0; k < w->cols.size(); ++k)
+						batch.push_back(element(i, w->cols[k], w->vals[k]));
+			}
+			M.scatter(batch);
+			return M;
+		}
+	}; // classe version
+
+	/**
+	 Lettore registrato: occupa uno slot finche' esiste. Un reader va usato da un
+	 solo thread alla volta; ogni thread lettore ne crea uno proprio.
+
+	 @brief registrazione di un lettore
+	*/
+	class reader {
+		const SnapshotSparseMatrix* m; ///< matrice letta
+		reader_slot* s; ///< slot del lettore
+
+		reader(const reader&); // non copiabile
+		reader& operator=(const reader&);
+
+	public:
+		/**
+		 Costruttore, occupa uno slot libero della matrice
+
+		 @param mm matrice da leggere
+		 @throw std::runtime_error se tutti gli slot sono occupati
+		*/
+		explicit reader(const SnapshotSparseMatrix& mm) : m(&mm), s(0) {
+			for (size_t k = 0; k < m->n_slot && s == 0; ++k) {
+				bool libero = false;
+				if (m->slots[k].occupato.compare_exchange_strong(libero, true, std::memory_order_acquire))
+					s = &m->slots[k];
+			}
+			if (s == 0)
+				throw std::runtime_error("SnapshotSparseMatrix: troppi lettori registrati");
+		}
+
+		/**
+		 Distruttore, libera lo slot
+		*/
+		~reader() {
+			s->epoca.store(0, std::memory_order_release);
+			s->occupato.store(false, std::memory_order_release);
+		}
+
+		/**
+		 Apre uno snapshot: annuncia l'epoca corrente nel proprio slot e legge la
+		 versione corrente. La versione resta valida fino a leave().
+		 Di solito si usa tramite la classe snapshot.
+		*/
+		const version& enter() {
+			assert(s->epoca.load(std::memory_order_relaxed) == 0);
+			s->epoca.store(m->epoca.load(std::memory_order_acquire), std::memory_order_relaxed);
+			// l'annuncio deve essere visibile allo scrittore prima di leggere il puntatore, vedi reclaim()
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return *m->corrente.load(std::memory_order_acquire);
+		}
+
+		/**
+		 Chiude lo snapshot aperto con enter()
+		*/
+		void leave() {
+			s->epoca.store(0, std::memory_order_release);
+		}
+
+		/**
+		 Legge (r;c) dalla versione corrente, con uno snapshot aperto solo per questa lettura
+
+		 @param r riga
+		 @param c colonna
+		*/
+		T get(const Index r, const Index c) {
+			const T v = enter()(r, c);
+			leave();
+			return v;
+		}
+	}; // classe reader
+
+	/**
+	 Snapshot aperto da un reader per la durata di un blocco: tutte le letture
+	 fatte tramite lo snapshot vedono la stessa versione.
+
+	 @brief versione letta da un lettore
+	*/
+	class snapshot {
+		reader& lettore; ///< lettore che ha aperto lo snapshot
+		const version* v; ///< versione letta
+
+		snapshot(const snapshot&); // non copiabile
+		snapshot& operator=(const snapshot&);
+
+	public:
+		/**
+		 Apre lo snapshot sulla versione corrente
+
+		 @param r lettore, senza altri snapshot aperti
+		*/
+		explicit snapshot(reader& r) : lettore(r), v(&r.enter()) {}
+
+		/**
+		 Chiude lo snapshot
+		*/
+		~snapshot() {
+			lettore.leave();
+		}
+
+		/**
+		 Ritorna la versione letta
+		*/
+		const version& operator*() const {
+			return *v;
+		}
+
+		/**
+		 Ritorna il puntatore alla versione letta
+		*/
+		const version* operator->() const {
+			return v;
+		}
+	}; // classe snapshot
+
+private:
+	/**
+	 Memoria sostituita da una pubblicazione, da liberare quando nessun lettore la puo' vedere
+	*/
+	struct rifiuto {
+		uint64_t epoca; ///< epoca globale dopo la pubblicazione
+		const version* v; ///< versione sostituita (solo la directory)
+		std::vector<const block*> blocchi; ///< blocchi sostituiti (senza le loro righe)
+		std::vector<const row*> righe; ///< righe sostituite
+	};
+
+	SparseMatrix<T, Index> bozza; ///< stato dello scrittore, non ancora pubblicato
+	std::vector<bool> sporca; ///< righe della bozza modificate dall'ultima pubblicazione
+	std::vector<Index> da_pubblicare; ///< elenco delle righe sporche
+	std::atomic<const version*> corrente; ///< ultima versione pubblicata
+	std::atomic<uint64_t> epoca; ///< epoca globale, incrementata a ogni pubblicazione
+	size_t n_slot; ///< numero di slot per i lettori
+	std::unique_ptr<reader_slot[]> slots; ///< slot dei lettori
+	std::vector<rifiuto> rifiuti; ///< memoria in attesa di essere liberata, per epoca crescente
+	uint64_t versione; ///< numero di versioni pubblicate, usato solo dallo scrittore
+
+	SnapshotSparseMatrix(const SnapshotSparseMatrix&); // non copiabile
+	SnapshotSparseMatrix& operator=(const SnapshotSparseMatrix&);
+
+	/**
+	 Segna la riga r come da ripubblicare
+	*/
+	void mark(const Index r) {
+		if (!sporca[r - 1]) {
+			da_pubblicare.push_back(r);
+			sporca[r - 1] = true;
+		}
+	}
+
+	/**
+	 Copia la riga r della bozza in una nuova riga immutabile, 0 se e' vuota
+
+	 @throw eccezione di allocazione di memoria
+	*/
+	const row* make_row(const Index r) const {
+		typename SparseMatrix<T, Index>::const_view v = bozza.row_view(r);
+		if (v.empty())
+			return 0;
+		std::unique_ptr<row> w(new row);
+		for (typename SparseMatrix<T, Index>::const_view::iterator Vb = v.begin(), Ve = v.end(); Vb != Ve; ++Vb) {
+			w->cols.push_back((*Vb).colonna);
+			w->vals.push_back((*Vb).dato);
+		}
+		return w.release();
+	}
+
+	/**
+	 Libera la memoria sostituita che nessun lettore puo' piu' vedere. Un lettore
+	 che ha annunciato un'epoca minore di quella di un rifiuto puo' ancora tenere
+	 la versione sostituita; uno che non e' stato visto nello slot ha eseguito la
+	 sua fence dopo quella dello scrittore, quindi legge gia' la nuova versione.
+	*/
+	void reclaim() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		uint64_t minimo = std::numeric_limits<uint64_t>::max();
+		for (size_t k = 0; k < n_slot; ++k) {
+			const uint64_t e = slots[k].epoca.load(std::memory_order_acquire);
+			if (e != 0 && e < minimo)
+				minimo = e;
+		}
+		size_t liberati = 0;
+		while (liberati < rifiuti.size() && rifiuti[liberati].epoca <= minimo) {
+			destroy(rifiuti[liberati]);
+			++liberati;
+		}
+		rifiuti.erase(rifiuti.begin(), rifiuti.begin() + liberati);
+	}
+
+	/**
+	 Libera la memoria di un rifiuto
+	*/
+	static void destroy(const rifiuto& r) {
+		for (size_t k = 0; k < r.righe.size(); ++k)
+			delete r.righe[k];
+		for (size_t k = 0; k < r.blocchi.size(); ++k)
+			delete r.blocchi[k];
+		delete r.v;
+	}
+
+public:
+	/**
+	 Costruttore, pubblica subito la matrice vuota
+
+	 @param r numero di righe
+	 @param c numero di colonne
+	 @param d dato di default
+	 @param max_lettori numero massimo di reader registrati contemporaneamente
+	 @throw eccezione di allocazione di memoria
+	*/
+	SnapshotSparseMatrix(const Index r, const Index c, const T& d, const size_t max_lettori = 64) : bozza(r, c, d),
+			sporca((size_t)r, false), corrente(0), epoca(1), n_slot(max_lettori), slots(new reader_slot[max_lettori]), versione(0) {
+		corrente.store(new version(r, c, d), std::memory_order_relaxed);
+		publish();
+	}
+
+	/**
+	 Costruttore, parte da una copia di M e la pubblica
+
+	 @param M matrice iniziale
+	 @param max_lettori numero massimo di reader registrati contemporaneamente
+	 @throw eccezione di allocazione di memoria
+	*/
+	explicit SnapshotSparseMatrix(const SparseMatrix<T, Index>& M, const size_t max_lettori = 64) : bozza(M),
+			sporca((size_t)M.get_righe(), false), corrente(0), epoca(1), n_slot(max_lettori), slots(new reader_slot[max_lettori]), versione(0) {
+		corrente.store(new version(M.get_righe(), M.get_colonne(), M.get_default()), std::memory_order_relaxed);
+		typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib)
+			mark((*Ib).riga);
+		publish();
+	}
+
+	/**
+	 Distruttore, da chiamare quando non esistono piu' reader
+	*/
+	~SnapshotSparseMatrix() {
+		for (size_t k = 0; k < rifiuti.size(); ++k)
+			destroy(rifiuti[k]);
+		const version* v = corrente.load(std::memory_order_relaxed);
+		for (size_t b = 0; b < v->blocchi.size(); ++b) {
+			if (v->blocchi[b] == 0)
+				continue;
+			for (size_t i = 0; i < block_rows; ++i)
+				delete v->blocchi[b]->righe[i];
+			delete v->blocchi[b];
+		}
+		delete v;
+	}
+
+	/**
+	 Inserisce un valore nella bozza (solo scrittore). Non e' visibile ai
+	 lettori fino al prossimo publish().
+
+	 @param r riga
+	 @param c colonna
+	 @param dato valore da inserire
+	 @throw eccezione di allocazione di memoria
+	*/
+	void add(const Index r, const Index c, const T& dato) {
+		bozza.add(r, c, dato);
+		mark(r);
+	}
+
+	/**
+	 Inserisce un gruppo di elementi nella bozza (solo scrittore), vedi SparseMatrix::scatter
+
+	 @param batch elementi da inserire
+	 @param policy politica di fusione
+	 @throw eccezione di allocazione di memoria
+	*/
+	void scatter(const std::vector<element>& batch, const merge_policy policy = SparseMatrix<T, Index>::replace) {
+		for (size_t k = 0; k < batch.size(); ++k)
+			mark(batch[k].riga);
+		bozza.scatter(batch, policy);
+	}
+
+	/**
+	 Ritorna la bozza dello scrittore (solo scrittore)
+	*/
+	const SparseMatrix<T, Index>& draft() const {
+		return bozza;
+	}
+
+	/**
+	 Pubblica la bozza come nuova versione (solo scrittore). Copia la directory,
+	 i blocchi con righe modificate e le righe modificate; il resto e' condiviso
+	 con la versione precedente. I lettori che aprono uno snapshot dopo il ritorno
+	 vedono tutte le modifiche precedenti; chi tiene uno snapshot vecchio continua
+	 a leggerlo invariato. Libera poi la memoria che nessun lettore vede piu'.
+	 Se l'allocazione fallisce nulla viene pubblicato e le righe restano da pubblicare.
+
+	 @return il numero della versione pubblicata
+	 @throw eccezione di allocazione di memoria
+	*/
+	uint64_t publish() {
+		const version* vecchia = corrente.load(std::memory_order_relaxed);
+		std::sort(da_pubblicare.begin(), da_pubblicare.end()); // righe dello stesso blocco vicine
+		std::unique_ptr<version> nuova(new version(*vecchia));
+		rifiuti.push_back(rifiuto());
+		rifiuto& r = rifiuti.back();
+		std::vector<block*> nuovi_blocchi;
+		std::vector<const row*> nuove_righe;
+		try {
+			r.righe.reserve(da_pubblicare.size());
+			nuove_righe.reserve(da_pubblicare.size());
+			block* blocco = 0;
+			size_t b_corrente = (size_t)-1;
+			for (size_t k = 0; k < da_pubblicare.size(); ++k) {
+				const size_t i = (size_t)(da_pubblicare[k] - 1);
+				const size_t b = i / block_rows;
+				if (b != b_corrente) { // primo cambiamento nel blocco: lo copio
+					blocco = (vecchia->blocchi[b] == 0) ? new block() : new block(*vecchia->blocchi[b]);
+					nuovi_blocchi.push_back(blocco);
+					if (vecchia->blocchi[b] != 0)
+						r.blocchi.push_back(vecchia->blocchi[b]);
+					nuova->blocchi[b] = blocco;
+					b_corrente = b;
+				}
+				const row* w = make_row(da_pubblicare[k]);
+				nuove_righe.push_back(w);
+				if (blocco->righe[i % block_rows] != 0)
+					r.righe.push_back(blocco->righe[i % block_rows]);
+				blocco->righe[i % block_rows] = w;
+			}
+		}
+		catch (...) {
+			for (size_t k = 0; k < nuove_righe.size(); ++k)
+				delete nuove_righe[k];
+			for (size_t k = 0; k < nuovi_blocchi.size(); ++k)
+				delete nuovi_blocchi[k];
+			rifiuti.pop_back();
+			throw;
+		}
+		for (size_t k = 0; k < da_pubblicare.size(); ++k)
+			sporca[da_pubblicare[k] - 1] = false;
+		da_pubblicare.clear();
+		nuova->size = bozza.get_size();
+		nuova->numero = ++versione;
+		r.v = vecchia;
+		corrente.store(nuova.release(), std::memory_order_release);
+		r.epoca = epoca.fetch_add(1, std::memory_order_acq_rel) + 1;
+		reclaim();
+		return versione;
+	}
+
+	/**
+	 Ritorna il numero di versioni pubblicate (solo scrittore)
+	*/
+	uint64_t get_version() const {
+		return versione;
+	}
+
+	/**
+	 Ritorna il numero di pubblicazioni la cui memoria non e' ancora stata
+	 liberata perche' qualche lettore poteva vederla (solo scrittore)
+	*/
+	size_t get_pending() const {
+		return rifiuti.size();
+	}
+};
+
+#endif
@@ -0,0 +1,720 @@
+#ifndef SOA_SPARSE_MATRIX_H
+#define SOA_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+#include "WorkStealing.h"
+
+#include <vector>
+
+/**
+ Matrice sparsa con disposizione "structure of arrays": righe, colonne e valori
+ degli elementi memorizzati stanno in tre array separati e contigui, in ordine
+ naturale. A differenza dei nodi di SparseMatrix, dove ogni dato e' affiancato
+ da indici e puntatori, le passate che toccano solo i valori (riduzioni,
+ trasformazioni, conteggi con un predicato) leggono un terzo della memoria e
+ il compilatore le puo' vettorizzare.
+ Un array di puntatori di riga permette di raggiungere ogni riga in O(1).
+ La struttura degli elementi e' fissa: si costruisce da una SparseMatrix e si
+ puo' riconvertire con to_matrix().
+
+ @brief matrice sparsa con righe, colonne e valori in array separati
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class SoASparseMatrix {
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	T D; ///< dato di default
+	std::vector<Index> row_idx; ///< riga di ogni elemento
+	std::vector<Index> col_idx; ///< colonna di ogni elemento
+	std::vector<T> dati; ///< valore di ogni elemento
+	std::vector<size_t> row_ptr; ///< gli elementi della riga r sono in [row_ptr[r-1];row_ptr[r])
+
+	/**
+	 Contributo parziale di un compito a una riga che divide con altri compiti
+	*/
+	struct bordo {
+		size_t riga; ///< riga (0-based), get_righe() se il compito non ne ha
+		T acc; ///< somma parziale dei prodotti
+		T somma; ///< somma parziale degli x delle colonne memorizzate
+	};
+
+	/**
+	 Numero di elementi per compito nelle versioni parallele: abbastanza piccolo
+	 da lasciare lavoro da rubare, abbastanza grande da ammortizzare il furto
+
+	 @param n numero di elementi
+	 @param threads numero di thread, 0 per uno per core
+	*/
+	static size_t grain(const size_t n, unsigned threads) {
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		return std::max<size_t>(2048, n / ((size_t)threads * 8));
+	}
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+
+	/**
+	 Costruttore, copia gli elementi di una SparseMatrix negli array
+
+	 @param M matrice da copiare
+	 @throw eccezione di allocazione di memoria
+	*/
+	explicit SoASparseMatrix(const SparseMatrix<T, Index>& M) : righe(M.get_righe()), colonne(M.get_colonne()), D(M.get_default()), row_ptr((size_t)M.get_righe() + 1, 0) {
+		row_idx.reserve(M.get_size());
+		col_idx.reserve(M.get_size());
+		dati.reserve(M.get_size());
+		typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib) {
+			row_idx.push_back((*Ib).riga);
+			col_idx.push_back((*Ib).colonna);
+			dati.push_back((*Ib).dato);
+			++row_ptr[(*Ib).riga];
+		}
+		for (Index i = 0; i < righe; ++i)
+			row_ptr[i + 1] += row_ptr[i];
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	size_t get_size() const {
+		return dati.size();
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Array delle righe degli elementi, get_size() valori
+	*/
+	const Index* rows() const {
+		return row_idx.data();
+	}
+
+	/**
+	 Array delle colonne degli elementi, get_size() valori
+	*/
+	const Index* cols() const {
+		return col_idx.data();
+	}
+
+	/**
+	 Array dei valori degli elementi, get_size() valori, modificabile
+	*/
+	T* values() {
+		return dati.data();
+	}
+
+	/**
+	 Array costante dei valori degli elementi
+	*/
+	const T* values() const {
+		return dati.data();
+	}
+
+	/**
+	 Ritorna la posizione del primo elemento della riga r negli array
+
+	 @param r riga, da 1 a get_righe() + 1
+	*/
+	size_t row_begin(const Index r) const {
+		return row_ptr[r - 1];
+	}
+
+	/**
+	 Ritorna il k-esimo elemento memorizzato in ordine naturale, in O(1)
+
+	 @param k posizione, da 0 a get_size() - 1
+	*/
+	element operator[](const size_t k) const {
+		assert(k < dati.size());
+		return element(row_idx[k], col_idx[k], dati[k]);
+	}
+
+	/**
+	 Iteratore costante ad accesso casuale sugli elementi in ordine naturale; gli
+	 elementi sono restituiti per valore. Salti e distanze costano O(1), quindi
+	 std::distance, std::lower_bound e le divisioni in parti sono immediate.
+	*/
+	class const_iterator {
+		const SoASparseMatrix* m;
+		size_t k; ///< posizione dell'elemento
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef element reference;
+
+		const_iterator() : m(0), k(0) {}
+
+		// Ritorna l'elemento riferito dall'iteratore
+		reference operator*() const {
+			return (*m)[k];
+		}
+
+		// Ritorna l'elemento a distanza n dall'iteratore
+		reference operator[](const difference_type n) const {
+			return (*m)[k + n];
+		}
+
+		// Operatore di iterazione post-incremento
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++k;
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		const_iterator& operator++() {
+			++k;
+			return *this;
+		}
+
+		// Operatore di iterazione post-decremento
+		const_iterator operator--(int) {
+			const_iterator tmp(*this);
+			--k;
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-decremento
+		const_iterator& operator--() {
+			--k;
+			return *this;
+		}
+
+		// Avanza di n posizioni
+		const_iterator& operator+=(const difference_type n) {
+			k += n;
+			return *this;
+		}
+
+		// Arretra di n posizioni
+		const_iterator& operator-=(const difference_type n) {
+			k -= n;
+			return *this;
+		}
+
+		// Iteratore spostato di n posizioni in avanti
+		const_iterator operator+(const difference_type n) const {
+			const_iterator tmp(*this);
+			return tmp += n;
+		}
+
+		// Iteratore spostato di n posizioni all'indietro
+		const_iterator operator-(const difference_type n) const {
+			const_iterator tmp(*this);
+			return tmp -= n;
+		}
+
+		// Distanza tra due iteratori
+		difference_type operator-(const const_iterator &other) const {
+			return (difference_type)k - (difference_type)other.k;
+		}
+
+		// Iteratore spostato di n posizioni in avanti
+		friend const_iterator operator+(const difference_type n, const const_iterator &it) {
+			return it + n;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (k == other.k);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return (k != other.k);
+		}
+
+		// Ordinamento per posizione
+		bool operator<(const const_iterator &other) const {
+			return (k < other.k);
+		}
+
+		bool operator>(const const_iterator &other) const {
+			return (k > other.k);
+		}
+
+		bool operator<=(const const_iterator &other) const {
+			return (k <= other.k);
+		}
+
+		bool operator>=(const const_iterator &other) const {
+			return (k >= other.k);
+		}
+
+	private:
+		friend class SoASparseMatrix;
+
+		// Costruttore privato di inizializzazione usato da begin e end
+		const_iterator(const SoASparseMatrix* mm, const size_t kk) : m(mm), k(kk) {}
+	}; // classe const_iterator
+
+	/**
+	 Ritorna l'iteratore costante all'inizio della sequenza dati
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	/**
+	 Ritorna l'iteratore costante alla fine della sequenza dati
+	*/
+	const_iterator end() const {
+		return const_iterator(this, dati.size());
+	}
+
+	/**
+	 Intervallo [first();last()) di posizioni negli array degli elementi.
+	 Si divide in O(1) per posizione o in O(log righe) sul confine di riga piu'
+	 vicino alla meta', e i suoi puntatori agli array sono iteratori ad accesso
+	 casuale, quindi le parti si possono dare a parallel_for, a un pool di thread
+	 o agli algoritmi paralleli della libreria standard.
+	*/
+	class range {
+		const SoASparseMatrix* m;
+		size_t lo; ///< prima posizione
+		size_t hi; ///< posizione dopo l'ultima
+	public:
+		range(const SoASparseMatrix* mm, const size_t l, const size_t h) : m(mm), lo(l), hi(h) {
+			assert(l <= h && h <= mm->get_size());
+		}
+
+		/**
+		 Prima posizione dell'intervallo
+		*/
+		size_t first() const {
+			return lo;
+		}
+
+		/**
+		 Posizione dopo l'ultima dell'intervallo
+		*/
+		size_t last() const {
+			return hi;
+		}
+
+		/**
+		 Numero di elementi dell'intervallo
+		*/
+		size_t size() const {
+			return hi - lo;
+		}
+
+		/**
+		 Ritorna true se l'intervallo non ha elementi
+		*/
+		bool empty() const {
+			return lo == hi;
+		}
+
+		/**
+		 Righe degli elementi dell'intervallo, size() valori
+		*/
+		const Index* rows() const {
+			return m->rows() + lo;
+		}
+
+		/**
+		 Colonne degli elementi dell'intervallo, size() valori
+		*/
+		const Index* cols() const {
+			return m->cols() + lo;
+		}
+
+		/**
+		 Valori degli elementi dell'intervallo, size() valori
+		*/
+		const T* values() const {
+			return m->values() + lo;
+		}
+
+		/**
+		 Iteratore ad accesso casuale al primo elemento dell'intervallo
+		*/
+		const_iterator begin() const {
+			return m->begin() + (ptrdiff_t)lo;
+		}
+
+		/**
+		 Iteratore ad accesso casuale alla fine dell'intervallo
+		*/
+		const_iterator end() const {
+			return m->begin() + (ptrdiff_t)hi;
+		}
+
+		/**
+		 Divide a meta' per numero di elementi in O(1); una riga puo' finire in entrambe le parti
+		*/
+		std::pair<range, range> split() const {
+			const size_t mid = lo + (hi - lo) / 2;
+			return std::make_pair(range(m, lo, mid), range(m, mid, hi));
+		}
+
+		/**
+		 Divide sul confine di riga piu' vicino alla meta', in O(log righe), cosi'
+		 ogni riga finisce in una sola parte. Se l'intervallo e' dentro una sola riga
+		 la seconda parte e' vuota.
+		*/
+		std::pair<range, range> split_rows() const {
+			const size_t mid = lo + (hi - lo) / 2;
+			const std::vector<size_t>& p = m->row_ptr;
+			std::vector<size_t>::const_iterator dopo = std::upper_bound(p.begin(), p.end(), mid);
+			size_t taglio = hi;
+			if (dopo != p.end() && *dopo < hi)
+				taglio = *dopo;
+			if (dopo != p.begin() && *(dopo - 1) > lo && (taglio == hi || mid - *(dopo - 1) < taglio - mid))
+				taglio = *(dopo - 1);
+			return std::make_pair(range(m, lo, taglio), range(m, taglio, hi));
+		}
+
+		/**
+		 Divide in k parti consecutive con lo stesso numero di elementi
+
+		 @param k numero di parti
+		 @return le parti, in ordine naturale
+		*/
+		std::vector<range> partition(const size_t k) const {
+			assert(k > 0);
+			std::vector<range> res;
+			res.reserve(k);
+			for (size_t p = 0; p < k; ++p)
+				res.push_back(range(m, lo + (hi - lo) * p / k, lo + (hi - lo) * (p + 1) / k));
+			return res;
+		}
+	}; // classe range
+
+	/**
+	 Ritorna l'intervallo di tutti gli elementi
+	*/
+	range all() const {
+		return range(this, 0, dati.size());
+	}
+
+	/**
+	 Ritorna in O(1) l'intervallo degli elementi delle righe da r0 a r1 comprese
+
+	 @param r0 prima riga
+	 @param r1 ultima riga
+	*/
+	range row_range(const Index r0, const Index r1) const {
+		assert(r0 > 0 && r0 <= r1 && r1 <= righe);
+		return range(this, row_ptr[r0 - 1], row_ptr[r1]);
+	}
+
+	/**
+	 Ritorna il valore in (r;c), con una ricerca binaria tra le colonne della riga r
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		const Index* first = col_idx.data() + row_ptr[r - 1];
+		const Index* last = col_idx.data() + row_ptr[r];
+		const Index* p = std::lower_bound(first, last, c);
+		if (p != last && *p == c)
+			return dati[p - col_idx.data()];
+		return D;
+	}
+
+	/**
+	 Applica f a ogni valore memorizzato e al dato di default, cosi' la matrice
+	 logica diventa f(M) casella per casella. Tocca solo l'array dei valori.
+
+	 @param f funtore T -> T
+	*/
+	template <typename F>
+	void transform_values(F f) {
+		T* v = dati.data();
+		const size_t n = dati.size();
+		for (size_t k = 0; k < n; ++k)
+			v[k] = f(v[k]);
+		D = f(D);
+	}
+
+	/**
+	 Versione parallela di transform_values, con i valori divisi in compiti di
+	 uguale numero di elementi. f viene chiamato da piu' thread contemporaneamente.
+
+	 @param f funtore T -> T
+	 @param threads numero di thread, 0 per usarne uno per core
+	*/
+	template <typename F>
+	void transform_values(F f, const unsigned threads) {
+		T* v = dati.data();
+		const size_t n = dati.size();
+		const size_t g = grain(n, threads);
+		parallel_for((n + g - 1) / g, [&](const size_t t) {
+			const size_t k1 = std::min(n, (t + 1) * g);
+			for (size_t k = t * g; k < k1; ++k)
+				v[k] = f(v[k]);
+		}, threads);
+		D = f(D);
+	}
+
+	/**
+	 Moltiplica tutte le caselle (default compreso) per a
+
+	 @param a fattore di scala
+	*/
+	void scale(const T& a) {
+		T* v = dati.data();
+		const size_t n = dati.size();
+		for (size_t k = 0; k < n; ++k)
+			v[k] *= a;
+		D *= a;
+	}
+
+	/**
+	 Somma dei valori memorizzati (le caselle di default non sono incluse)
+	*/
+	T sum_values() const {
+		const T* v = dati.data();
+		const size_t n = dati.size();
+		T acc = T();
+		for (size_t k = 0; k < n; ++k)
+			acc += v[k];
+		return acc;
+	}
+
+	/**
+	 Conta le caselle della matrice logica che verificano il predicato p:
+	 i valori memorizzati vengono scanditi una sola volta, mentre le caselle
+	 di default contano tutte insieme con un'unica valutazione di p(D).
+
+	 @param p predicato
+	*/
+	template <typename P>
+	size_t count_if(P& p) const {
+		const T* v = dati.data();
+		const size_t n = dati.size();
+		size_t counter = 0;
+		for (size_t k = 0; k < n; ++k)
+			if (p(v[k]))
+				++counter;
+		if (p(D))
+			counter += (size_t)righe * (size_t)colonne - n;
+		return counter;
+	}
+
+	/**
+	 Versione parallela di count_if: i valori sono divisi in compiti di uguale
+	 numero di elementi, distribuiti con parallel_for. p viene chiamato da piu'
+	 thread contemporaneamente.
+
+	 @param p predicato
+	 @param threads numero di thread, 0 per usarne uno per core
+	*/
+	template <typename P>
+	size_t count_if(P& p, const unsigned threads) const {
+		const T* v = dati.data();
+		const size_t n = dati.size();
+		const size_t g = grain(n, threads);
+		std::vector<size_t> parziali((n + g - 1) / g, 0);
+		parallel_for(parziali.size(), [&](const size_t t) {
+			const size_t k1 = std::min(n, (t + 1) * g);
+			size_t c = 0; // contatore locale: i parziali vicini sono nella stessa cache line
+			for (size_t k = t * g; k < k1; ++k)
+				if (p(v[k]))
+					++c;
+			parziali[t] = c;
+		}, threads);
+		size_t counter = 0;
+		for (size_t t = 0; t < parziali.size(); ++t)
+			counter += parziali[t];
+		if (p(D))
+			counter += (size_t)righe * (size_t)colonne - n;
+		return counter;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x, scorrendo gli array una riga alla volta.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const default_correction<T> correzione(D, x, colonne);
+		const Index* c = col_idx.data();
+		const T* v = dati.data();
+		for (Index i = 0; i < righe; ++i) {
+			T acc = zero;
+			T somma_memorizzati = zero;
+			for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k)
+				acc += v[k] * x[c[k] - 1];
+			if (correzione.active())
+				for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k)
+					somma_memorizzati += x[c[k] - 1];
+			y[i] = correzione(acc, somma_memorizzati);
+		}
+	}
+
+	/**
+	 Versione parallela di spmv, bilanciata sul numero di elementi e non di righe:
+	 gli elementi sono divisi in compiti di uguale dimensione distribuiti con
+	 un solo parallel_for, quindi una riga molto lunga viene spezzata tra piu'
+	 compiti. Ogni compito scrive per intero, correzione del default compresa,
+	 le righe che contiene per intero e le righe vuote che iniziano nel suo
+	 intervallo; i contributi alle righe divise con altri compiti (al piu' la
+	 prima e l'ultima) vengono sommati alla fine.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	 @param threads numero di thread, 0 per usarne uno per core
+	*/
+	void spmv(const T* x, T* y, const unsigned threads) const {
+		const size_t n = dati.size();
+		if (n == 0) {
+			spmv(x, y);
+			return;
+		}
+		const T zero = T();
+		const default_correction<T> correzione(D, x, colonne);
+		const size_t nr = (size_t)righe;
+		const Index* c = col_idx.data();
+		const T* v = dati.data();
+		const size_t g = grain(n, threads);
+		const bordo nessuno = {nr, zero, zero};
+		std::vector<bordo> bordi(2 * ((n + g - 1) / g), nessuno);
+		parallel_for(bordi.size() / 2, [&](const size_t t) {
+			const size_t k0 = t * g, k1 = std::min(n, k0 + g);
+			// prima riga con elementi in [k0;k1) o vuota che inizia in k0
+			size_t i = std::lower_bound(row_ptr.begin(), row_ptr.end(), k0) - row_ptr.begin();
+			if (i > 0 && row_ptr[i] > k0)
+				--i;
+			// l'ultimo compito prende anche le righe vuote in fondo
+			for (; i < nr && (row_ptr[i] < k1 || k1 == n); ++i) {
+				const size_t a = std::max(row_ptr[i], k0), b = std::min(row_ptr[i + 1], k1);
+				T acc = zero;
+				T somma = zero;
+				for (size_t k = a; k < b; ++k)
+					acc += v[k] * x[c[k] - 1];
+				if (correzione.active())
+					for (size_t k = a; k < b; ++k)
+						somma += x[c[k] - 1];
+				if (row_ptr[i] >= k0 && row_ptr[i + 1] <= k1)
+					y[i] = correzione(acc, somma);
+				else {
+					bordo& p = bordi[2 * t + (row_ptr[i] < k0 ? 0 : 1)];
+					p.riga = i;
+					p.acc = acc;
+					p.somma = somma;
+				}
+			}
+		}, threads);
+		// le parti di una stessa riga divisa sono consecutive tra i bordi usati
+		size_t riga = nr;
+		T acc = zero;
+		T somma = zero;
+		for (size_t k = 0; k <= bordi.size(); ++k) {
+			if (k < bordi.size() && bordi[k].riga >= nr)
+				continue;
+			if (riga < nr && (k == bordi.size() || bordi[k].riga != riga)) {
+				y[riga] = correzione(acc, somma);
+				riga = nr;
+			}
+			if (k == bordi.size())
+				break;
+			if (riga == nr) {
+				riga = bordi[k].riga;
+				acc = zero;
+				somma = zero;
+			}
+			acc += bordi[k].acc;
+			somma += bordi[k].somma;
+		}
+	}
+
+	/**
+	 Ricostruisce la matrice a lista
+
+	 @return la matrice a lista con gli stessi elementi
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> to_matrix() const {
+		SparseMatrix<T, Index> M(righe, colonne, D);
+		std::vector<element> batch;
+		batch.reserve(dati.size());
+		for (size_t k = 0; k < dati.size(); ++k)
+			batch.push_back(element(row_idx[k], col_idx[k], dati[k]));
+		M.scatter(batch);
+		return M;
+	}
+};
+
+/**
+ Versione di evaluate per SoASparseMatrix: conta le caselle che verificano il
+ predicato scandendo solo l'array dei valori.
+
+ @param M SoASparseMatrix di tipo T
+ @param p predicato
+*/
+template <typename T, typename Index, typename P>
+size_t evaluate(const SoASparseMatrix<T, Index>& M, P& p) {
+	return M.count_if(p);
+}
+
+/**
+ Versione parallela di evaluate per SoASparseMatrix, vedi count_if
+
+ @param M SoASparseMatrix di tipo T
+ @param p predicato, chiamato da piu' thread contemporaneamente
+ @param threads numero di thread, 0 per usarne uno per core
+*/
+template <typename T, typename Index, typename P>
+size_t evaluate(const SoASparseMatrix<T, Index>& M, P& p, const unsigned threads) {
+	return M.count_if(p, threads);
+}
+
+/**
+ Prodotto matrice-vettore su una matrice SoA
+
+ @param M matrice SoA
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename Index>
+void spmv(const SoASparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+/**
+ Prodotto matrice-vettore parallelo bilanciato sul numero di elementi
+
+ @param M matrice SoA
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+ @param threads numero di thread, 0 per usarne uno per core
+*/
+template <typename T, typename Index>
+void spmv(const SoASparseMatrix<T, Index>& M, const T* x, T* y, const unsigned threads) {
+	M.spmv(x, y, threads);
+}
+
+#endif
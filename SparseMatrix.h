@@ -9,17 +9,23 @@
 #include <iterator> 
 #include <cstddef>
 #include <cassert>
+#include <vector>
+#include <utility>
+#include <atomic>
+
+#include "WorkStealing.h"
 
 /**
  Classe SparseMatrix. Crea una matrice sparsa con utilizzo di memoria minimale,
  solo gli elementi inseriti sono effettivamente memorizzati. Accetta dati di 
  tipo generico T. E' strutturata come una lista doppiamente linkata costituita da
  nodi e la struttura element contenente le informazioni di riga, colonna e dato T
- in quella posizione.
+ in quella posizione. Il tipo intero Index di righe e colonne e' configurabile:
+ ad esempio uint16_t per piccoli blocchi, int64_t per matrici con miliardi di righe.
 
  @brief Definizione della classe templata SparseMatrix.
 */
-template <typename T> ///< T = tipo generico
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
 class SparseMatrix {
 public:
 	/**
@@ -29,8 +35,8 @@ public:
 	 @brief l'elemento esposto dall'iteratore
 	*/
 	struct element {
-		const int riga; ///< posizione riga
-		const int colonna; ///< posizione colonna
+		const Index riga; ///< posizione riga
+		const Index colonna; ///< posizione colonna
 		T dato; ///< dato della casella nella matrice
 		/**
 		 Costruttore dell'elemento
@@ -39,7 +45,7 @@ public:
 		 @param c colonna
 		 @param d dato
 		*/
-		element(const int r, const int c, const T& d) : riga(r), colonna(c), dato(d) {}
+		element(const Index r, const Index c, const T& d) : riga(r), colonna(c), dato(d) {}
 		
 		// gli altri metodi fondamentali sono quelli di default
 	};
@@ -67,30 +73,117 @@ private:
 		 @param n nodo successivo
 		 @param p nodo precedente
 		*/
-		node(const T& k, const int r, const int c, node* n, node* p) : next(n), prev(p), e(r, c, k) {}
+		node(const T& k, const Index r, const Index c, node* n, node* p) : next(n), prev(p), e(r, c, k) {}
 		
 		// gli altri metodi fondamentali sono quelli di default
 		
 	};
 
 	node* head; ///< puntatore alla testa della lista
-	const int righe; ///< numero di righe della matrice
-	const int colonne; ///< numero di colonne della matrice
-	unsigned int size; ///< numero di elementi memorizzati nella matrice
+	node* tail; ///< puntatore alla coda della lista
+	node** row_head; ///< directory delle righe: row_head[r-1] punta al primo nodo della riga r, 0 se la riga e' vuota
+	Index* row_tree; ///< albero di Fenwick sulle righe non vuote, per trovare la prossima riga non vuota in O(log righe)
+	Index righe; ///< numero di righe della matrice
+	Index colonne; ///< numero di colonne della matrice
+	size_t size; ///< numero di elementi memorizzati nella matrice
 	T D; ///< dato di default da ritornare se viene richiesto un elemento non presente nella matrice
+	mutable std::atomic<node*> finger; ///< ultimo nodo visitato, punto di partenza della ricerca successiva
+
+	/**
+	 Ritorna il finger (ultimo nodo visitato). Il finger e' atomico con ordinamento
+	 rilassato, cosi' le letture const concorrenti restano prive di data race come se
+	 non ci fosse: ogni lettore vede sempre un nodo valido della lista, e su x86 la
+	 load e la store rilassate sono normali mov.
+	*/
+	node* get_finger() const {
+		return finger.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 Aggiorna il finger
+	 
+	 @param n nuovo ultimo nodo visitato
+	*/
+	void set_finger(node* n) const {
+		finger.store(n, std::memory_order_relaxed);
+	}
 	
 	/**
-	 Funzione helper di clear, cancella ricorsivamente la matrice a partire dal nodo passato fino alla fine
+	 Alloca la directory delle righe e il suo albero, vuoti. Se fallisce non resta nulla allocato.
+	 
+	 @throw eccezione di allocazione di memoria
+	*/
+	void alloc_rows() {
+		row_head = new node*[righe]();
+		try {
+			row_tree = new Index[righe]();
+		}
+		catch (...) {
+			delete[] row_head;
+			row_head = 0;
+			throw;
+		}
+	}
+
+	/**
+	 Libera la directory delle righe e il suo albero
+	*/
+	void free_rows() {
+		delete[] row_head;
+		delete[] row_tree;
+		row_head = 0;
+		row_tree = 0;
+	}
+
+	/**
+	 Segna la riga r come diventata non vuota o vuota nell'albero delle righe
+	 
+	 @param r riga
+	 @param piena true se la riga ha appena ricevuto il primo nodo, false se ha perso l'ultimo
+	*/
+	void mark_row(const Index r, const bool piena) {
+		for (size_t i = (size_t)r; i <= (size_t)righe; i += i & (0 - i)) {
+			if (piena)
+				++row_tree[i - 1];
+			else
+				--row_tree[i - 1];
+		}
+	}
+
+	/**
+	 Ritorna la prima riga non vuota a partire da r (compresa), 0 se non esiste.
+	 Conta le righe non vuote prima di r e scende nell'albero fino alla successiva: O(log righe).
+	 
+	 @param r riga da cui cercare
+	*/
+	Index next_row(const Index r) const {
+		size_t k = 0; // righe non vuote prima di r
+		for (size_t i = (size_t)r - 1; i > 0; i -= i & (0 - i))
+			k += (size_t)row_tree[i - 1];
+		size_t pos = 0, passo = 1;
+		while (passo <= (size_t)righe / 2)
+			passo *= 2;
+		for (; passo > 0; passo /= 2) {
+			if (pos + passo <= (size_t)righe && (size_t)row_tree[pos + passo - 1] <= k) {
+				pos += passo;
+				k -= (size_t)row_tree[pos - 1];
+			}
+		}
+		return (pos < (size_t)righe) ? (Index)(pos + 1) : 0;
+	}
+
+	/**
+	 Funzione helper di clear, cancella la matrice a partire dal nodo passato fino alla fine.
+	 Iterativa per non esaurire lo stack su liste molto lunghe.
 	 
 	 @param n nodo da cui partire per la liberazione di memoria
 	*/	
 	void clear_helper(node* n) {
-		if (n == 0)
-			return;
-		node* tmp = n->next;
-		delete n;
-		n = 0;
-		clear_helper(tmp);
+		while (n != 0) {
+			node* tmp = n->next;
+			delete n;
+			n = tmp;
+		}
 	}
 
 	/**
@@ -99,12 +192,182 @@ private:
 	void clear() {
 		clear_helper(head);
 		head = 0;
+		tail = 0;
 		size = 0;
+		set_finger(0);
+		std::fill(row_head, row_head + righe, (node*)0);
+		std::fill(row_tree, row_tree + righe, (Index)0);
+	}
+
+	/**
+	 Cerca la casella (r;c). Se l'ultimo nodo visitato (finger) e' sulla riga r la ricerca
+	 parte da li', andando avanti o indietro con i puntatori prev; altrimenti si salta
+	 direttamente al primo nodo della riga r tramite la directory delle righe.
+	 Cosi' gli accessi a caselle vicine costano O(1) ammortizzato.
+	 Se la casella non e' memorizzata ritorna 0 e imposta pred al nodo dopo il quale
+	 andrebbe inserita (0 se andrebbe inserita in testa). Se la riga r e' vuota il
+	 predecessore si trova con l'albero delle righe in O(log righe).
+	 
+	 @param r riga
+	 @param c colonna
+	 @param pred nodo predecessore della posizione di inserimento
+	 @return il nodo in (r;c) oppure 0
+	*/
+	node* locate(const Index r, const Index c, node*& pred) const {
+		node* n = get_finger();
+		if (n != 0 && n->e.riga == r && n->e.colonna > c) { // torno indietro lungo la riga
+			while (n->prev != 0 && n->prev->e.riga == r && n->prev->e.colonna >= c)
+				n = n->prev;
+			set_finger(n);
+			pred = n->prev;
+			return (n->e.colonna == c) ? n : 0;
+		}
+		if (n == 0 || n->e.riga != r)
+			n = row_head[r - 1];
+		if (n != 0) {
+			pred = n->prev;
+			while (n != 0 && n->e.riga == r && n->e.colonna < c) {
+				pred = n;
+				n = n->next;
+			}
+			if (n != 0 && n->e.riga == r && n->e.colonna == c) {
+				set_finger(n);
+				return n;
+			}
+			if (pred != 0 && pred->e.riga == r)
+				set_finger(pred);
+			return 0;
+		}
+		// riga vuota: il predecessore e' il nodo che precede la prima riga non vuota successiva
+		if (tail == 0 || tail->e.riga < r) {
+			pred = tail;
+			return 0;
+		}
+		const Index s = next_row(r);
+		pred = (s == 0) ? tail : row_head[s - 1]->prev;
+		return 0;
+	}
+
+	/**
+	 Funtore di confronto per ordinare gli indici di un insieme di richieste (riga;colonna)
+	 in ordine naturale della matrice.
+	*/
+	struct query_less {
+		const Index* rows; ///< righe delle richieste
+		const Index* cols; ///< colonne delle richieste
+		query_less(const Index* r, const Index* c) : rows(r), cols(c) {}
+		bool operator()(const size_t a, const size_t b) const {
+			return rows[a] < rows[b] || (rows[a] == rows[b] && cols[a] < cols[b]);
+		}
+	};
+
+	/**
+	 Collega il nodo current subito dopo pred (in testa se pred e' 0),
+	 aggiornando coda, directory delle righe e numero di elementi.
+	 
+	 @param pred nodo predecessore
+	 @param current nodo da inserire
+	*/
+	void link_after(node* pred, node* current) {
+		current->prev = pred;
+		current->next = (pred == 0) ? head : pred->next;
+		if (current->next != 0)
+			current->next->prev = current;
+		else
+			tail = current;
+		if (pred != 0)
+			pred->next = current;
+		else
+			head = current;
+		if (pred == 0 || pred->e.riga != current->e.riga) {
+			if (row_head[current->e.riga - 1] == 0)
+				mark_row(current->e.riga, true);
+			row_head[current->e.riga - 1] = current;
+		}
+		set_finger(current);
+		++size;
+	}
+
+	/**
+	 Stacca e libera il nodo n, aggiornando testa, coda, directory delle righe,
+	 finger e numero di elementi.
+	 
+	 @param n nodo da rimuovere
+	*/
+	void unlink(node* n) {
+		const Index r = n->e.riga;
+		if (n->prev != 0)
+			n->prev->next = n->next;
+		else
+			head = n->next;
+		if (n->next != 0)
+			n->next->prev = n->prev;
+		else
+			tail = n->prev;
+		if (row_head[r - 1] == n) {
+			if (n->next != 0 && n->next->e.riga == r) {
+				row_head[r - 1] = n->next;
+			}
+			else {
+				row_head[r - 1] = 0;
+				mark_row(r, false);
+			}
+		}
+		if (get_finger() == n)
+			set_finger(n->prev);
+		--size;
+		delete n;
 	}
 
+	/**
+	 Funtore di confronto per ordinare gli indici di un insieme di elementi
+	 in ordine naturale della matrice.
+	*/
+	struct element_less {
+		const std::vector<element>& batch; ///< elementi da ordinare
+		element_less(const std::vector<element>& b) : batch(b) {}
+		bool operator()(const size_t a, const size_t b) const {
+			return batch[a].riga < batch[b].riga || (batch[a].riga == batch[b].riga && batch[a].colonna < batch[b].colonna);
+		}
+	};
+
 public:
 	typedef T value_type; ///< tipo di dato
 
+	/**
+	 Politiche di fusione usate da scatter() quando una casella riceve un nuovo valore.
+	 Per le caselle non memorizzate il vecchio valore e' il dato di default.
+	*/
+	enum merge_policy {
+		replace, ///< il nuovo valore sostituisce il vecchio
+		accumulate, ///< il nuovo valore viene sommato al vecchio
+		keep_min, ///< resta il minore tra vecchio e nuovo valore
+		keep_max ///< resta il maggiore tra vecchio e nuovo valore
+	};
+
+private:
+	/**
+	 Applica la politica di fusione
+	 
+	 @param old valore attuale della casella
+	 @param v nuovo valore
+	 @param policy politica di fusione
+	*/
+	static T merge(const T& old, const T& v, const merge_policy policy) {
+		switch (policy) {
+		case accumulate:
+			return old + v;
+		case keep_min:
+			return (v < old) ? v : old;
+		case keep_max:
+			return (old < v) ? v : old;
+		default:
+			return v;
+		}
+	}
+
+public:
+
 	/**
 	 Costruttore della matrice
 	 
@@ -112,12 +375,13 @@ public:
 	 @param c numero di colonne
 	 @param d dato di default
 	*/
-	SparseMatrix(const int r, const int c, const T& d) : size(0), head(0), D(d), righe(r), colonne(c) {
+	SparseMatrix(const Index r, const Index c, const T& d) : size(0), head(0), tail(0), row_head(0), row_tree(0), finger(0), D(d), righe(r), colonne(c) {
 #ifdef DEBUG
 		std::cout << "Creazione matrice " << righe << "x" << colonne << std::endl;
 #endif
 		assert(r > 0);
 		assert(c > 0);
+		alloc_rows();
 	}
 	
 	/**
@@ -128,16 +392,21 @@ public:
 		std::cout << "Distruzione matrice " << righe << "x" << colonne << std::endl;
 #endif
 		clear();
+		free_rows();
 	}
 
 	SparseMatrix& operator=(const SparseMatrix& other) {
 		if (this != &other) {
 			SparseMatrix tmp(other);
 			std::swap(head, tmp.head);
+			std::swap(tail, tmp.tail);
+			std::swap(row_head, tmp.row_head);
+			std::swap(row_tree, tmp.row_tree);
 			std::swap(righe, tmp.righe);
 			std::swap(colonne, tmp.colonne);
 			std::swap(D, tmp.D);
 			std::swap(size, tmp.size);
+			set_finger(0);
 		}
 
 		return *this;
@@ -146,21 +415,21 @@ public:
 	/**
 	 Ritorna pubblicamente il numero di elementi attualmente inseriti
 	*/
-	unsigned int get_size() const {
+	size_t get_size() const {
 		return size;
 	}
 	
 	/**
 	 Getter per le righe
 	*/
-	const int get_righe() const {
+	Index get_righe() const {
 		return righe;
 	}
 
 	/**
 	 Getter per le colonne
 	*/
-	const int get_colonne() const {
+	Index get_colonne() const {
 		return colonne;
 	}
 	
@@ -186,16 +455,18 @@ public:
 	 @param other matrice da copiare
 	 @throw eccezione di allocazione di memoria
 	*/
-	SparseMatrix(const SparseMatrix& other) : head(0), size(0), righe(other.righe), colonne(other.colonne), D(other.D) {
+	SparseMatrix(const SparseMatrix& other) : head(0), tail(0), row_head(0), row_tree(0), finger(0), size(0), righe(other.righe), colonne(other.colonne), D(other.D) {
+		alloc_rows();
 		const node* tmp = other.head;
 		try {
-			while (tmp != 0) {
-				add(tmp->e.riga, tmp->e.colonna, tmp->e.dato);
+			while (tmp != 0) { // la sorgente e' gia' ordinata, accodo direttamente
+				link_after(tail, new node(tmp->e.dato, tmp->e.riga, tmp->e.colonna, 0, 0));
 				tmp = tmp->next;
 			}
 		}
 		catch (...) {
 			clear();
+			free_rows();
 			throw;
 		}
 
@@ -211,118 +482,171 @@ public:
 	 @param other matrice da copiare
 	 @throw eccezione di allocazione di memoria
 	*/
-	template <typename Q>
-	SparseMatrix(const SparseMatrix<Q>& other) : head(0), size(0), righe(other.get_righe()), colonne(other.get_colonne()) {
-		SparseMatrix<Q> tmp(other);
-		typename SparseMatrix<Q>::iterator Ib, Ie;
+	template <typename Q, typename J>
+	SparseMatrix(const SparseMatrix<Q, J>& other) : head(0), tail(0), row_head(0), row_tree(0), finger(0), size(0), righe((Index)other.get_righe()), colonne((Index)other.get_colonne()) {
+		alloc_rows();
+		SparseMatrix<Q, J> tmp(other);
+		typename SparseMatrix<Q, J>::iterator Ib, Ie;
 		static_cast<T>((*Ib).dato); //check di castabilita' @ compile-time
 		D = (T)other.get_default();
 		Ib = tmp.begin();
 		Ie = tmp.end();
 		try {
 			for (; Ib != Ie; ++Ib) {
-				add((*Ib).riga, (*Ib).colonna, (T)(*Ib).dato);
+				add((Index)(*Ib).riga, (Index)(*Ib).colonna, (T)(*Ib).dato);
 			}
 		}
 		catch (...) {
 			clear();
+			free_rows();
 			throw;
 		}
 	}
 	
 	/**
 	 Metodo per aggiungere un elemento alla matrice. Crea un nuovo nodo e verifica di inserirlo in ordine naturale
-	 (da sinistra a destra e dall'alto verso il basso).
-	  Se la posizione esiste gia' lo scarta e si limita ad aggiornare il valore nel vecchio nodo.
+	 (da sinistra a destra e dall'alto verso il basso). Grazie alla directory delle righe la ricerca
+	 della posizione scandisce solo i nodi della riga r.
+	  Se la posizione esiste gia' si limita ad aggiornare il valore nel vecchio nodo.
 	  
 	  @param r riga
 	  @param c colonna
 	  @param value valore da mettere nella matrice, di tipo T
 	*/
-	void add(const int r, const int c, const value_type& value) {
+	void add(const Index r, const Index c, const value_type& value) {
 		assert(r <= righe && r > 0);
 		assert(c <= colonne && c > 0);
 		assert(value != D);
-		node* current = new node(value, r, c, 0, 0); ///< anche se fallisce, non ho ancora cambiato lo stato della classe quindi puo' fallire in sicurezza
-		if (head == 0) {
+		node* pred = 0;
+		node* n = locate(r, c, pred);
+		if (n != 0) {
 #ifdef DEBUG
-			std::cout << "Testa vuota, aggiungo l'elemento: " << value << std::endl;
+			std::cout << "aggiorno valore in (" << r << ";" << c << ") con " << value << std::endl;
 #endif
-			head = current;
-			++size;
+			n->e.dato = value;
 			return;
 		}
-		node* n = head;
-		while (n != 0) {
-			if (r < n->e.riga || r == n->e.riga && c < n->e.colonna) {
-				if (n->prev == 0) { ///< aggiungo in testa
-#ifdef DEBUG
-					std::cout << "aggiungo in testa il val " << value << std::endl;
-#endif
-					current->prev = 0;
-					current->next = head;
-					head->prev = current;
-					head = current;
-					++size;
-					break;
-				}
-				else { ///< aggiungo in mezzo
-#ifdef DEBUG
-					std::cout << "aggiungo in mezzo il val " << value << std::endl;
-#endif
-					current->next = n->prev->next;
-					current->prev = n->prev;
-					n->prev->next = current;
-					n->prev = current;
-					++size;
-					break;
-				}
-			}
-			if (r == n->e.riga && c == n->e.colonna) {
-#ifdef DEBUG
-				std::cout << "aggiorno valore in (" << r << ";" << c << ") con " << current->e.dato << std::endl;
-#endif	
-				n->e.dato = current->e.dato;
-				delete current;
-				break;
-			}
-			if (r > n->e.riga || r == n->e.riga && c > n->e.colonna) {
-				if (n->next ==0) { ///< aggiungo in coda
+		node* current = new node(value, r, c, 0, 0); ///< anche se fallisce, non ho ancora cambiato lo stato della classe quindi puo' fallire in sicurezza
 #ifdef DEBUG
-					std::cout << "aggiungo in coda il val " << value << std::endl;
+		std::cout << "aggiungo il val " << value << " in (" << r << ";" << c << ")" << std::endl;
 #endif
-					current->prev = n;
-					current->next = 0;
-					n->next = current;
-					++size;
-					break;
-				}
-				n = n->next;
-			}
-		}
+		link_after(pred, current);
 	}
 	
 	/**
 	 Definizione di operator() sulla matrice. alla richiesta della coppia riga;colonna,
 	 ritorna il valore dell'elemento in quella posizione e, se non esistente, ritorna il
-	 valore di default.
+	 valore di default. Scandisce solo i nodi della riga r.
+	 Aggiorna il finger, che e' atomico: piu' thread possono chiamarlo insieme
+	 sulla stessa matrice, purche' nessuno la modifichi nel frattempo.
 	 
 	 @param r riga
 	 @param c colonna
 	*/
-	const T& operator()(const int r, const int c) const {
+	const T& operator()(const Index r, const Index c) const {
 		assert(r <= righe && r > 0);
 		assert(c <= colonne && c > 0);
-		node* n = head;
-		while (n != 0) {
-			if (n->e.riga == r && n->e.colonna == c)
-				return n->e.dato;
-			if (n->next == 0)
-				return D;
+		node* pred = 0;
+		node* n = locate(r, c, pred);
+		if (n != 0)
+			return n->e.dato;
+		return D; ///< se la casella non e' memorizzata ritorna il valore di default
+	}
+
+	/**
+	 Lettura a blocchi: ritorna in out[k] il valore della casella (rows[k];cols[k]) per k = 0..n-1.
+	 Le richieste vengono ordinate internamente e risolte con un'unica scansione ordinata
+	 delle righe coinvolte, invece di n ricerche indipendenti. I risultati sono scritti
+	 nell'ordine originale delle richieste.
+	 
+	 @param rows righe richieste
+	 @param cols colonne richieste
+	 @param out array di n valori in uscita
+	 @param n numero di richieste
+	 @throw eccezione di allocazione di memoria
+	*/
+	void gather(const Index* rows, const Index* cols, T* out, const size_t n) const {
+		std::vector<size_t> order(n);
+		for (size_t k = 0; k < n; ++k) {
+			assert(rows[k] <= righe && rows[k] > 0);
+			assert(cols[k] <= colonne && cols[k] > 0);
+			order[k] = k;
+		}
+		std::sort(order.begin(), order.end(), query_less(rows, cols));
+		node* cur = 0;
+		Index riga_corrente = 0;
+		for (size_t k = 0; k < n; ++k) {
+			const size_t q = order[k];
+			const Index r = rows[q];
+			const Index c = cols[q];
+			if (r != riga_corrente) { // salto al primo nodo della nuova riga
+				cur = row_head[r - 1];
+				riga_corrente = r;
+			}
+			while (cur != 0 && cur->e.riga == r && cur->e.colonna < c)
+				cur = cur->next;
+			if (cur != 0 && cur->e.riga == r && cur->e.colonna == c)
+				out[q] = cur->e.dato;
 			else
+				out[q] = D;
+		}
+	}
+
+	/**
+	 Scrittura a blocchi: fonde gli elementi di batch nella matrice secondo la politica scelta.
+	 Il blocco viene ordinato (in modo stabile, quindi caselle ripetute sono fuse nell'ordine
+	 del blocco) e poi fuso con la lista in un'unica scansione, entrando in ogni riga
+	 tramite la directory delle righe.
+	 Le caselle il cui valore risultante e' il dato di default non restano memorizzate: quelle
+	 nuove non vengono create, quelle esistenti vengono rimosse (e i loro iteratori invalidati).
+	 Se l'allocazione fallisce gli elementi gia' fusi restano nella matrice.
+	 
+	 @param batch elementi da fondere
+	 @param policy politica di fusione, replace se omessa
+	 @throw eccezione di allocazione di memoria
+	*/
+	void scatter(const std::vector<element>& batch, const merge_policy policy = replace) {
+		std::vector<size_t> order(batch.size());
+		for (size_t k = 0; k < batch.size(); ++k) {
+			assert(batch[k].riga <= righe && batch[k].riga > 0);
+			assert(batch[k].colonna <= colonne && batch[k].colonna > 0);
+			order[k] = k;
+		}
+		std::stable_sort(order.begin(), order.end(), element_less(batch));
+		node* pred = 0;
+		node* n = 0;
+		Index riga_corrente = 0;
+		for (size_t k = 0; k < order.size(); ++k) {
+			const element& el = batch[order[k]];
+			const Index r = el.riga;
+			const Index c = el.colonna;
+			if (r != riga_corrente) {
+				n = row_head[r - 1];
+				if (n != 0)
+					pred = n->prev;
+				else
+					locate(r, c, pred);
+				riga_corrente = r;
+			}
+			while (n != 0 && n->e.riga == r && n->e.colonna < c) {
+				pred = n;
 				n = n->next;
+			}
+			if (n != 0 && n->e.riga == r && n->e.colonna == c) {
+				n->e.dato = merge(n->e.dato, el.dato, policy);
+				if (n->e.dato == D) { // nessun elemento memorizzato puo' valere D
+					node* dopo = n->next;
+					unlink(n);
+					n = dopo;
+				}
+				continue;
+			}
+			const T val = merge(D, el.dato, policy);
+			if (val == D)
+				continue;
+			n = new node(val, r, c, 0, 0);
+			link_after(pred, n);
 		}
-		return D; ///< se la matrice e' vuota ritorna il valore di default
 	}
 
 #ifdef DEBUG
@@ -359,20 +683,22 @@ public:
 	*/
 	class iterator {
 		node* n;
+		const SparseMatrix* m; ///< matrice, serve a end() per tornare indietro sull'ultimo nodo
 	public:
-		typedef std::forward_iterator_tag iterator_category;
+		typedef std::bidirectional_iterator_tag iterator_category;
 		typedef element value_type;
 		typedef ptrdiff_t difference_type;
 		typedef element* pointer;
 		typedef element& reference;
 
 	
-		iterator() : n(0) {}
+		iterator() : n(0), m(0) {}
 		
-		iterator(const iterator &other) : n(other.n) {}
+		iterator(const iterator &other) : n(other.n), m(other.m) {}
 
 		iterator& operator=(const iterator &other) {
 			n = other.n;
+			m = other.m;
 
 			return *this;
 		}
@@ -404,6 +730,21 @@ public:
 			return *this;
 		}
 
+		// Operatore di iterazione post-decremento
+		iterator operator--(int) {
+			iterator tmp(*this);
+			--(*this);
+
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-decremento, da end() va sull'ultimo elemento
+		iterator& operator--() {
+			n = (n == 0) ? m->tail : n->prev;
+
+			return *this;
+		}
+
 		// Uguaglianza
 		bool operator==(const iterator &other) const {
 			return (n == other.n);
@@ -438,7 +779,7 @@ public:
 
 		// Costruttore privato di inizializzazione usato dalla classe container
 		// tipicamente nei metodi begin e end
-		iterator(node* nn) : n(nn) {}
+		iterator(node* nn, const SparseMatrix* mm) : n(nn), m(mm) {}
 		
 		// !!! Eventuali altri metodi privati
 		
@@ -448,14 +789,14 @@ public:
 	 Ritorna l'iteratore all'inizio della sequenza dati
 	*/
 	iterator begin() {
-		return iterator(head);
+		return iterator(head, this);
 	}
 
 	/**
 	 Ritorna l'iteratore alla fine della sequenza dati
 	*/
 	iterator end() {
-		return iterator(0);
+		return iterator(0, this);
 	}
 	
 	/**
@@ -463,26 +804,31 @@ public:
 	*/
 	class const_iterator {
 		node* n;
+		const SparseMatrix* m; ///< matrice, serve a end() per tornare indietro sull'ultimo nodo
 	public:
-		typedef std::forward_iterator_tag iterator_category;
+		typedef std::bidirectional_iterator_tag iterator_category;
 		typedef element value_type;
 		typedef ptrdiff_t difference_type;
 		typedef const element* pointer;
 		typedef const element& reference;
 
 	
-		const_iterator() : n(0) {}
+		const_iterator() : n(0), m(0) {}
 		
-		const_iterator(const const_iterator &other) : n(other.n) {}
+		const_iterator(const const_iterator &other) : n(other.n), m(other.m) {}
+
+		const_iterator(const iterator &other) : n(other.n), m(other.m) {}
 
 		const_iterator& operator=(const const_iterator &other) {
 			n = other.n;
+			m = other.m;
 
 			return *this;
 		}
 
 		const_iterator& operator=(const iterator& other) {
 			n = other.n;
+			m = other.m;
 
 			return *this;
 		}
@@ -513,6 +859,21 @@ public:
 			return *this;
 		}
 
+		// Operatore di iterazione post-decremento
+		const_iterator operator--(int) {
+			const_iterator tmp(*this);
+			--(*this);
+
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-decremento, da end() va sull'ultimo elemento
+		const_iterator& operator--() {
+			n = (n == 0) ? m->tail : n->prev;
+
+			return *this;
+		}
+
 		// Uguaglianza
 		bool operator==(const const_iterator &other) const {
 			return (n == other.n);
@@ -548,7 +909,7 @@ public:
 
 		// Costruttore privato di inizializzazione usato dalla classe container
 		// tipicamente nei metodi begin e end
-		const_iterator(node* nn) : n(nn) {}
+		const_iterator(node* nn, const SparseMatrix* mm) : n(nn), m(mm) {}
 		
 		// !!! Eventuali altri metodi privati
 		
@@ -558,16 +919,507 @@ public:
 	 Ritorna l'iteratore constante all'inizio della sequenza dati
 	*/
 	const_iterator begin() const {
-		return const_iterator(head);
+		return const_iterator(head, this);
 	}
 	
 	/**
 	 Ritorna l'iteratore costante alla fine della sequenza dati
 	*/
 	const_iterator end() const {
-		return const_iterator(0);
+		return const_iterator(0, this);
+	}
+
+	typedef std::reverse_iterator<iterator> reverse_iterator; ///< iteratore all'indietro
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator; ///< iteratore costante all'indietro
+
+	/**
+	 Ritorna l'iteratore all'indietro sull'ultimo elemento
+	*/
+	reverse_iterator rbegin() {
+		return reverse_iterator(end());
+	}
+
+	/**
+	 Ritorna l'iteratore all'indietro prima del primo elemento
+	*/
+	reverse_iterator rend() {
+		return reverse_iterator(begin());
+	}
+
+	/**
+	 Ritorna l'iteratore costante all'indietro sull'ultimo elemento
+	*/
+	const_reverse_iterator rbegin() const {
+		return const_reverse_iterator(end());
 	}
 
+	/**
+	 Ritorna l'iteratore costante all'indietro prima del primo elemento
+	*/
+	const_reverse_iterator rend() const {
+		return const_reverse_iterator(begin());
+	}
+
+	/**
+	 Iteratore costante in ordine denso: visita tutte le caselle riga per riga,
+	 comprese quelle non memorizzate, per le quali restituisce il dato di default.
+	 Avanza in parallelo sulla lista degli elementi, quindi una visita completa
+	 costa O(righe * colonne) senza alcuna ricerca.
+	*/
+	class dense_iterator {
+		const SparseMatrix* m;
+		Index i; ///< riga corrente (0-based)
+		Index j; ///< colonna corrente (0-based)
+		const node* n; ///< primo elemento memorizzato non ancora superato
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		dense_iterator() : m(0), i(0), j(0), n(0) {}
+
+		// Ritorna il dato della casella corrente, D se non e' memorizzata
+		reference operator*() const {
+			return stored() ? n->e.dato : m->D;
+		}
+
+		// Ritorna il puntatore al dato della casella corrente
+		pointer operator->() const {
+			return &(**this);
+		}
+
+		// Riga della casella corrente
+		Index riga() const {
+			return i + 1;
+		}
+
+		// Colonna della casella corrente
+		Index colonna() const {
+			return j + 1;
+		}
+
+		// Ritorna true se la casella corrente e' un elemento memorizzato
+		bool stored() const {
+			return n != 0 && n->e.riga == i + 1 && n->e.colonna == j + 1;
+		}
+
+		// Operatore di iterazione post-incremento
+		dense_iterator operator++(int) {
+			dense_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		dense_iterator& operator++() {
+			if (stored())
+				n = n->next;
+			if (++j == m->colonne) {
+				j = 0;
+				++i;
+			}
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const dense_iterator &other) const {
+			return (i == other.i && j == other.j);
+		}
+
+		// Diversita'
+		bool operator!=(const dense_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class SparseMatrix;
+
+		// Costruttore privato di inizializzazione usato da dense_begin e dense_end
+		dense_iterator(const SparseMatrix* mm, const Index ii, const node* nn) : m(mm), i(ii), j(0), n(nn) {}
+	}; // classe dense_iterator
+
+	/**
+	 Ritorna l'iteratore denso sulla casella (1;1)
+	*/
+	dense_iterator dense_begin() const {
+		return dense_iterator(this, 0, head);
+	}
+
+	/**
+	 Ritorna l'iteratore denso dopo l'ultima casella
+	*/
+	dense_iterator dense_end() const {
+		return dense_iterator(this, righe, 0);
+	}
+
+	/*
+	#########
+	# VIEWS #
+	#########
+	*/
+private:
+	/**
+	 Finestra rettangolare [r0;r1]x[c0;c1] su una matrice, condivisa dalle viste e dai loro
+	 iteratori (che ne tengono una copia, cosi' restano validi anche se la vista era temporanea).
+	 
+	 @brief limiti di una vista
+	*/
+	struct window {
+		const SparseMatrix* m; ///< matrice osservata
+		Index r0; ///< prima riga della finestra
+		Index r1; ///< ultima riga della finestra
+		Index c0; ///< prima colonna della finestra
+		Index c1; ///< ultima colonna della finestra
+
+		/**
+		 Ritorna il primo nodo memorizzato a partire dalla riga r + 1 (entro r1), 0 se non esiste.
+		 Usa l'albero delle righe non vuote, quindi costa O(log righe) anche con molte righe vuote.
+		 Prende la riga precedente invece della prima riga cercata, cosi' non c'e' overflow
+		 quando r1 e' il massimo valore rappresentabile da Index.
+		 
+		 @param r riga dopo la quale cercare
+		*/
+		node* first_after_row(const Index r) const {
+			if (r >= r1)
+				return 0;
+			const Index s = m->next_row(r + 1);
+			return (s != 0 && s <= r1) ? m->row_head[s - 1] : 0;
+		}
+
+		/**
+		 Dato un nodo n della riga r con colonna < c0, ritorna il primo nodo della riga
+		 con colonna >= c0, oppure il nodo dopo la riga se non ce ne sono. La lista non
+		 permette salti dentro una riga, quindi si cerca da entrambi i capi della riga
+		 (l'ultimo nodo si trova con l'albero delle righe): il costo e' O(log righe) piu'
+		 il minimo tra i nodi a sinistra di c0 e quelli da c0 in poi.
+		 
+		 @param n nodo a sinistra della finestra
+		*/
+		node* skip_left(node* n) const {
+			const Index r = n->e.riga;
+			const Index s = (r < m->righe) ? m->next_row(r + 1) : 0;
+			node* fine = (s == 0) ? m->tail : m->row_head[s - 1]->prev; // ultimo nodo della riga r
+			if (fine->e.colonna < c0) // tutta la riga e' a sinistra della finestra
+				return fine->next;
+			// n e' prima di c0 e fine da c0 in poi: i due capi si avvicinano restando nella riga
+			for (;;) {
+				n = n->next;
+				if (n->e.colonna >= c0)
+					return n;
+				if (fine->prev->e.colonna < c0)
+					return fine;
+				fine = fine->prev;
+			}
+		}
+
+		/**
+		 Ritorna il primo nodo della finestra a partire da n (compreso), 0 se non esiste.
+		 Salta le colonne prima di c0 con skip_left e quelle oltre c1 passando
+		 direttamente alla riga successiva.
+		 
+		 @param n nodo da cui partire
+		*/
+		node* settle(node* n) const {
+			while (n != 0) {
+				if (n->e.riga > r1)
+					return 0;
+				if (n->e.colonna < c0)
+					n = skip_left(n);
+				else if (n->e.colonna > c1)
+					n = first_after_row(n->e.riga);
+				else
+					return n;
+			}
+			return 0;
+		}
+	};
+
+public:
+	/**
+	 Vista non proprietaria su una finestra rettangolare [r0;r1]x[c0;c1] della matrice.
+	 Non copia nulla: i suoi iteratori scorrono direttamente i nodi della matrice,
+	 entrando in ogni riga tramite la directory delle righe. Per le viste a righe
+	 intere si visitano solo gli elementi della finestra; se c0 > 1, in ogni riga non
+	 vuota si visitano anche fino a min(elementi prima di c0, elementi da c0 in poi)
+	 nodi in piu', perche' la lista non permette salti dentro una riga. Le righe vuote
+	 si saltano in O(log righe). La vista resta valida finche' la matrice
+	 non viene distrutta o svuotata.
+	 
+	 @brief vista su righe, colonne o sottomatrici senza copia
+	*/
+	template <typename E> ///< E = element oppure const element
+	class basic_view {
+		window w; ///< limiti della vista
+	public:
+		/**
+		 Iteratore della vista, scorre in ordine naturale gli elementi della finestra
+		*/
+		class iterator {
+			node* n;
+			window w;
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef element value_type;
+			typedef ptrdiff_t difference_type;
+			typedef E* pointer;
+			typedef E& reference;
+
+			iterator() : n(0) {}
+
+			// Ritorna il dato riferito dall'iteratore (dereferenziamento)
+			reference operator*() const {
+				return n->e;
+			}
+
+			// Ritorna il puntatore al dato riferito dall'iteratore
+			pointer operator->() const {
+				return &(n->e);
+			}
+
+			// Operatore di iterazione post-incremento
+			iterator operator++(int) {
+				iterator tmp(*this);
+				n = w.settle(n->next);
+				return tmp;
+			}
+
+			// Operatore di iterazione pre-incremento
+			iterator& operator++() {
+				n = w.settle(n->next);
+				return *this;
+			}
+
+			// Uguaglianza
+			bool operator==(const iterator &other) const {
+				return (n == other.n);
+			}
+
+			// Diversita'
+			bool operator!=(const iterator &other) const {
+				return (n != other.n);
+			}
+
+		private:
+			friend class basic_view;
+
+			// Costruttore privato di inizializzazione usato dalla vista
+			iterator(node* nn, const window& ww) : n(nn), w(ww) {}
+		}; // classe iterator
+
+		/**
+		 Costruttore della vista, usato dai metodi *_view della matrice
+		 
+		 @param m matrice osservata
+		 @param r0 prima riga
+		 @param r1 ultima riga
+		 @param c0 prima colonna
+		 @param c1 ultima colonna
+		*/
+		basic_view(const SparseMatrix* m, const Index r0, const Index r1, const Index c0, const Index c1) {
+			assert(r0 > 0 && r0 <= r1 && r1 <= m->righe);
+			assert(c0 > 0 && c0 <= c1 && c1 <= m->colonne);
+			w.m = m;
+			w.r0 = r0;
+			w.r1 = r1;
+			w.c0 = c0;
+			w.c1 = c1;
+		}
+
+		/**
+		 Ritorna l'iteratore al primo elemento della finestra
+		*/
+		iterator begin() const {
+			return iterator(w.settle(w.first_after_row(w.r0 - 1)), w);
+		}
+
+		/**
+		 Ritorna l'iteratore alla fine della finestra
+		*/
+		iterator end() const {
+			return iterator(0, w);
+		}
+
+		/**
+		 Ritorna true se nella finestra non ci sono elementi memorizzati
+		*/
+		bool empty() const {
+			return begin() == end();
+		}
+
+		/**
+		 Getter per la prima riga della finestra
+		*/
+		Index first_row() const {
+			return w.r0;
+		}
+
+		/**
+		 Getter per l'ultima riga della finestra
+		*/
+		Index last_row() const {
+			return w.r1;
+		}
+
+		/**
+		 Ritorna true se la finestra ha piu' di una riga o di una colonna e quindi si puo' dividere
+		*/
+		bool is_divisible() const {
+			return w.r1 > w.r0 || w.c1 > w.c0;
+		}
+
+		/**
+		 Divide la finestra in due meta' disgiunte in O(1): per righe se ne ha piu'
+		 di una, altrimenti per colonne. Le due viste si possono scorrere da thread
+		 diversi, perche' gli iteratori delle viste non toccano il finger della matrice.
+		 
+		 @return la prima e la seconda meta', in ordine naturale
+		*/
+		std::pair<basic_view, basic_view> split() const {
+			assert(is_divisible());
+			if (w.r1 > w.r0) {
+				const Index mid = w.r0 + (w.r1 - w.r0) / 2;
+				return std::make_pair(basic_view(w.m, w.r0, mid, w.c0, w.c1), basic_view(w.m, mid + 1, w.r1, w.c0, w.c1));
+			}
+			const Index mid = w.c0 + (w.c1 - w.c0) / 2;
+			return std::make_pair(basic_view(w.m, w.r0, w.r1, w.c0, mid), basic_view(w.m, w.r0, w.r1, mid + 1, w.c1));
+		}
+
+		/**
+		 Divide la finestra per righe in al piu' k viste consecutive con lo stesso
+		 numero di righe (una per riga se le righe sono meno di k)
+		 
+		 @param k numero di parti
+		 @return le parti, in ordine naturale
+		*/
+		std::vector<basic_view> partition(const size_t k) const {
+			assert(k > 0);
+			const size_t n = (size_t)(w.r1 - w.r0) + 1;
+			const size_t parti = std::min(k, n);
+			std::vector<basic_view> res;
+			res.reserve(parti);
+			for (size_t p = 0; p < parti; ++p)
+				res.push_back(basic_view(w.m, (Index)(w.r0 + n * p / parti), (Index)(w.r0 + n * (p + 1) / parti - 1), w.c0, w.c1));
+			return res;
+		}
+	}; // classe basic_view
+
+	typedef basic_view<element> view; ///< vista in lettura e scrittura
+	typedef basic_view<const element> const_view; ///< vista in sola lettura
+
+	/**
+	 Vista sulla riga r
+	 
+	 @param r riga
+	*/
+	view row_view(const Index r) {
+		return view(this, r, r, 1, colonne);
+	}
+
+	/**
+	 Vista costante sulla riga r
+	 
+	 @param r riga
+	*/
+	const_view row_view(const Index r) const {
+		return const_view(this, r, r, 1, colonne);
+	}
+
+	/**
+	 Vista sulla colonna c
+	 
+	 @param c colonna
+	*/
+	view col_view(const Index c) {
+		return view(this, 1, righe, c, c);
+	}
+
+	/**
+	 Vista costante sulla colonna c
+	 
+	 @param c colonna
+	*/
+	const_view col_view(const Index c) const {
+		return const_view(this, 1, righe, c, c);
+	}
+
+	/**
+	 Vista sulle righe da r0 a r1 comprese
+	 
+	 @param r0 prima riga
+	 @param r1 ultima riga
+	*/
+	view rows_view(const Index r0, const Index r1) {
+		return view(this, r0, r1, 1, colonne);
+	}
+
+	/**
+	 Vista costante sulle righe da r0 a r1 comprese
+	 
+	 @param r0 prima riga
+	 @param r1 ultima riga
+	*/
+	const_view rows_view(const Index r0, const Index r1) const {
+		return const_view(this, r0, r1, 1, colonne);
+	}
+
+	/**
+	 Vista sulla sottomatrice [r0;r1]x[c0;c1]
+	 
+	 @param r0 prima riga
+	 @param r1 ultima riga
+	 @param c0 prima colonna
+	 @param c1 ultima colonna
+	*/
+	view submatrix_view(const Index r0, const Index r1, const Index c0, const Index c1) {
+		return view(this, r0, r1, c0, c1);
+	}
+
+	/**
+	 Vista costante sulla sottomatrice [r0;r1]x[c0;c1]
+	 
+	 @param r0 prima riga
+	 @param r1 ultima riga
+	 @param c0 prima colonna
+	 @param c1 ultima colonna
+	*/
+	const_view submatrix_view(const Index r0, const Index r1, const Index c0, const Index c1) const {
+		return const_view(this, r0, r1, c0, c1);
+	}
+
+	/**
+	 Applica f a ogni valore memorizzato e al dato di default, cosi' la matrice
+	 logica diventa f(M) casella per casella. Gli elementi il cui nuovo valore e'
+	 uguale al nuovo default restano memorizzati, come dopo set_default.
+
+	 @param f funtore T -> T
+	*/
+	template <typename F>
+	void transform_values(F f) {
+		for (node* n = head; n != 0; n = n->next)
+			n->e.dato = f(n->e.dato);
+		D = f(D);
+	}
+
+	/**
+	 Versione parallela di transform_values: le righe sono divise in blocchi
+	 consecutivi (viste, che non toccano il finger) distribuiti con parallel_for.
+	 Una riga non viene mai divisa tra piu' compiti. f viene chiamato da piu'
+	 thread contemporaneamente.
+
+	 @param f funtore T -> T
+	 @param threads numero di thread, 0 per usarne uno per core
+	*/
+	template <typename F>
+	void transform_values(F f, const unsigned threads) {
+		const std::vector<view> parti = rows_view(1, righe).partition(work_tasks(threads));
+		parallel_for(parti.size(), [&](const size_t t) {
+			for (typename view::iterator Vb = parti[t].begin(), Ve = parti[t].end(); Vb != Ve; ++Vb)
+				(*Vb).dato = f((*Vb).dato);
+		}, threads);
+		D = f(D);
+	}
 };
 
 /**
@@ -577,24 +1429,173 @@ public:
  @param M SparseMatrix di tipo T
  @param p predicato
 */
-template <typename T, typename P>
-const int evaluate(SparseMatrix<T>& M, P& p) {
-	int counter = 0;
-	for (int i = 1; i <= M.get_righe(); ++i) {
-		for (int j = 1; j <= M.get_colonne(); ++j) {
+template <typename T, typename Index, typename P>
+size_t evaluate(const SparseMatrix<T, Index>& M, P& p) {
+	size_t counter = 0;
+	typename SparseMatrix<T, Index>::dense_iterator Ib = M.dense_begin(), Ie = M.dense_end();
+	for (; Ib != Ie; ++Ib) { // una sola passata: i default arrivano dall'iteratore, senza cercare ogni casella
 #ifdef DEBUG
-			std::cout << "testing (" << i << ";" << j << ")" << std::endl;
+		std::cout << "testing (" << Ib.riga() << ";" << Ib.colonna() << ")" << std::endl;
 #endif
-			if (p(M(i, j))) {
-				++counter;
+		if (p(*Ib)) {
+			++counter;
 #ifdef DEBUG
-				std::cout << "Found matching on (" << i << ";" << j << ")" << std::endl;
+			std::cout << "Found matching on (" << Ib.riga() << ";" << Ib.colonna() << ")" << std::endl;
 #endif
-			}
 		}
 	}
 	
 	return counter;
 }
 
+/**
+ Versione parallela di evaluate: le righe sono divise in blocchi consecutivi
+ (viste, che non toccano il finger) distribuiti con parallel_for, e ogni compito
+ conta gli elementi memorizzati del suo blocco. Le caselle di default contano
+ tutte insieme con un'unica valutazione di p(D). p viene chiamato da piu'
+ thread contemporaneamente. Una riga non viene mai divisa tra piu' compiti:
+ per righe con moltissimi elementi conviene SoASparseMatrix, che divide per elementi.
+
+ @param M SparseMatrix di tipo T
+ @param p predicato
+ @param threads numero di thread, 0 per usarne uno per core
+*/
+template <typename T, typename Index, typename P>
+size_t evaluate(const SparseMatrix<T, Index>& M, P& p, const unsigned threads) {
+	typedef typename SparseMatrix<T, Index>::const_view const_view;
+	const std::vector<const_view> parti = M.rows_view(1, M.get_righe()).partition(work_tasks(threads));
+	std::vector<size_t> parziali(parti.size(), 0);
+	parallel_for(parti.size(), [&](const size_t t) {
+		size_t c = 0;
+		for (typename const_view::iterator Vb = parti[t].begin(), Ve = parti[t].end(); Vb != Ve; ++Vb)
+			if (p((*Vb).dato))
+				++c;
+		parziali[t] = c;
+	}, threads);
+	size_t counter = 0;
+	for (size_t t = 0; t < parziali.size(); ++t)
+		counter += parziali[t];
+	if (p(M.get_default()))
+		counter += (size_t)M.get_righe() * (size_t)M.get_colonne() - M.get_size();
+	return counter;
+}
+
+/**
+ Correzione del dato di default nel prodotto matrice-vettore, usata da spmv di
+ tutte le rappresentazioni. Le caselle non memorizzate di una riga valgono D,
+ quindi il loro contributo si aggiunge per differenza: D * (somma di x - somma
+ degli x delle colonne memorizzate nella riga). Se D e' T() la correzione e'
+ nulla e active() ritorna false, cosi' il kernel puo' non calcolare la somma
+ degli x memorizzati.
+
+ @brief contributo delle caselle di default a una riga di y = M * x
+*/
+template <typename T>
+class default_correction {
+	T D; ///< dato di default
+	bool attiva; ///< true se D non e' T()
+	T somma_x; ///< somma di tutti gli x, calcolata solo se attiva
+
+public:
+	/**
+	 Costruttore, somma x se la correzione serve
+
+	 @param d dato di default
+	 @param x vettore di colonne elementi
+	 @param colonne numero di colonne
+	*/
+	template <typename Index>
+	default_correction(const T& d, const T* x, const Index colonne) : D(d), attiva(!(d == T())), somma_x(T()) {
+		if (attiva)
+			for (Index j = 0; j < colonne; ++j)
+				somma_x += x[j];
+	}
+
+	/**
+	 Ritorna true se le caselle di default contribuiscono e quindi serve la somma degli x memorizzati
+	*/
+	bool active() const {
+		return attiva;
+	}
+
+	/**
+	 Ritorna il valore finale di una riga
+
+	 @param acc somma dei prodotti degli elementi memorizzati della riga
+	 @param somma_memorizzati somma degli x delle colonne memorizzate nella riga, ignorata se !active()
+	*/
+	T operator()(const T& acc, const T& somma_memorizzati) const {
+		return attiva ? acc + D * (somma_x - somma_memorizzati) : acc;
+	}
+};
+
+/**
+ Prodotto matrice-vettore y = M * x. Le caselle non memorizzate valgono il dato
+ di default, aggiunto con default_correction. I vettori sono indicizzati da 0:
+ x[j - 1] corrisponde alla colonna j. Le altre rappresentazioni hanno un spmv
+ con la stessa firma e lo stesso risultato.
+ 
+ @param M SparseMatrix di tipo T
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi, sovrascritto con il risultato
+*/
+template <typename T, typename Index>
+void spmv(const SparseMatrix<T, Index>& M, const T* x, T* y) {
+	const T zero = T();
+	const default_correction<T> correzione(M.get_default(), x, M.get_colonne());
+	typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+	for (Index i = 0; i < M.get_righe(); ++i) {
+		T acc = zero;
+		T somma_memorizzati = zero;
+		for (; Ib != Ie && (*Ib).riga - 1 == i; ++Ib) {
+			acc += (*Ib).dato * x[(*Ib).colonna - 1];
+			if (correzione.active())
+				somma_memorizzati += x[(*Ib).colonna - 1];
+		}
+		y[i] = correzione(acc, somma_memorizzati);
+	}
+}
+
+/**
+ Versione parallela di spmv: le righe sono divise in blocchi consecutivi (viste,
+ che non toccano il finger) distribuiti con parallel_for, e ogni compito scrive
+ le righe di y del suo blocco. Il furto di lavoro bilancia blocchi con numeri di
+ elementi diversi, ma una riga non viene mai divisa tra piu' compiti: per righe
+ con moltissimi elementi conviene SoASparseMatrix, che divide per elementi.
+
+ @param M SparseMatrix di tipo T
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi, sovrascritto con il risultato
+ @param threads numero di thread, 0 per usarne uno per core
+*/
+template <typename T, typename Index>
+void spmv(const SparseMatrix<T, Index>& M, const T* x, T* y, const unsigned threads) {
+	typedef typename SparseMatrix<T, Index>::const_view const_view;
+	const T zero = T();
+	const default_correction<T> correzione(M.get_default(), x, M.get_colonne());
+	const std::vector<const_view> parti = M.rows_view(1, M.get_righe()).partition(work_tasks(threads));
+	parallel_for(parti.size(), [&](const size_t t) {
+		Index i = parti[t].first_row();
+		T acc = zero;
+		T somma_memorizzati = zero;
+		for (typename const_view::iterator Vb = parti[t].begin(), Ve = parti[t].end(); Vb != Ve; ++Vb) {
+			for (; i < (*Vb).riga; ++i) { // chiude la riga corrente e quelle vuote prima dell'elemento
+				y[i - 1] = correzione(acc, somma_memorizzati);
+				acc = zero;
+				somma_memorizzati = zero;
+			}
+			acc += (*Vb).dato * x[(*Vb).colonna - 1];
+			if (correzione.active())
+				somma_memorizzati += x[(*Vb).colonna - 1];
+		}
+		for (;; ++i) { // ultima riga e righe vuote in fondo; niente ++i oltre last_row(), che puo' essere il massimo di Index
+			y[i - 1] = correzione(acc, somma_memorizzati);
+			if (i == parti[t].last_row())
+				break;
+			acc = zero;
+			somma_memorizzati = zero;
+		}
+	}, threads);
+}
+
 #endif
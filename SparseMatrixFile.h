@@ -0,0 +1,788 @@
+#ifndef SPARSE_MATRIX_FILE_H
+#define SPARSE_MATRIX_FILE_H
+
+#include "SparseMatrix.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ Intestazione del formato binario nativo di SparseMatrix (versione 2).
+ Il file e' composto dall'intestazione seguita da quattro sezioni, ognuna
+ allineata a SPARSE_FILE_ALIGN byte cosi' da poter essere usata direttamente
+ dopo mmap:
+ - dato di default (value_size byte)
+ - puntatori di riga: righe + 1 interi uint64_t, la riga r occupa le posizioni [ptr[r-1];ptr[r])
+ - colonne: nnz indici di index_width byte, 1-based come SparseMatrix::element::colonna
+ - valori: nnz dati di value_size byte
+ Tutti i campi sono nell'ordine dei byte della macchina che ha scritto il file,
+ registrato in byte_order: chi legge su una macchina con ordine diverso rifiuta il file.
+
+ @brief intestazione del file binario
+*/
+struct sparse_file_header {
+	char magic[8]; ///< "SPMATRIX"
+	uint32_t version; ///< versione del formato
+	uint32_t index_width; ///< byte per indice di colonna
+	uint32_t value_size; ///< byte per valore
+	uint32_t byte_order; ///< SPARSE_FILE_BYTE_ORDER scritto con l'ordine dei byte dello scrittore
+	int64_t righe; ///< numero di righe
+	int64_t colonne; ///< numero di colonne
+	uint64_t nnz; ///< numero di elementi memorizzati
+	uint64_t default_offset; ///< posizione del dato di default
+	uint64_t row_ptr_offset; ///< posizione dei puntatori di riga
+	uint64_t col_offset; ///< posizione degli indici di colonna
+	uint64_t val_offset; ///< posizione dei valori
+	uint64_t file_size; ///< dimensione totale del file
+};
+
+const uint32_t SPARSE_FILE_VERSION = 2; ///< versione corrente del formato binario
+const uint32_t SPARSE_FILE_BYTE_ORDER = 0x01020304; ///< marcatore dell'ordine dei byte
+const uint64_t SPARSE_FILE_ALIGN = 64; ///< allineamento delle sezioni
+
+/**
+ Arrotonda una posizione al prossimo multiplo di SPARSE_FILE_ALIGN
+
+ @param x posizione
+*/
+inline uint64_t sparse_file_align(const uint64_t x) {
+	return (x + SPARSE_FILE_ALIGN - 1) / SPARSE_FILE_ALIGN * SPARSE_FILE_ALIGN;
+}
+
+/**
+ Calcola le posizioni delle sezioni di un file binario a partire da
+ dimensioni, numero di elementi e larghezze di indici e valori.
+
+ @param h intestazione da completare
+*/
+inline void sparse_file_layout(sparse_file_header& h) {
+	h.default_offset = sparse_file_align(sizeof(sparse_file_header));
+	h.row_ptr_offset = sparse_file_align(h.default_offset + h.value_size);
+	h.col_offset = sparse_file_align(h.row_ptr_offset + (uint64_t)(h.righe + 1) * sizeof(uint64_t));
+	h.val_offset = sparse_file_align(h.col_offset + h.nnz * h.index_width);
+	h.file_size = h.val_offset + h.nnz * h.value_size;
+}
+
+/**
+ Verifica l'intestazione: firma, ordine dei byte, versione, larghezze attese dal
+ lettore, dimensioni e posizioni delle sezioni rispetto alla lunghezza del file.
+
+ @param h intestazione letta
+ @param length lunghezza del file in byte
+ @param index_width byte per indice del lettore
+ @param value_size byte per valore del lettore
+ @param filename percorso del file, per i messaggi di errore
+ @throw std::runtime_error se il file non e' valido
+*/
+inline void sparse_file_check_header(const sparse_file_header& h, const uint64_t length, const uint32_t index_width,
+		const uint32_t value_size, const char* filename) {
+	if (std::memcmp(h.magic, "SPMATRIX", 8) != 0)
+		throw std::runtime_error(std::string("sparse_file: firma non valida in ") + filename);
+	if (h.byte_order != SPARSE_FILE_BYTE_ORDER)
+		throw std::runtime_error(std::string("sparse_file: ordine dei byte diverso da quello della macchina in ") + filename);
+	if (h.version != SPARSE_FILE_VERSION || h.index_width != index_width || h.value_size != value_size)
+		throw std::runtime_error(std::string("sparse_file: formato non compatibile ") + filename);
+	// i limiti su righe e nnz evitano overflow nel calcolo delle posizioni
+	if (h.righe <= 0 || h.colonne <= 0
+			|| (uint64_t)h.righe >= length / sizeof(uint64_t) || h.nnz > length)
+		throw std::runtime_error(std::string("sparse_file: intestazione non valida in ") + filename);
+	sparse_file_header atteso = h;
+	sparse_file_layout(atteso);
+	if (h.default_offset != atteso.default_offset || h.row_ptr_offset != atteso.row_ptr_offset
+			|| h.col_offset != atteso.col_offset || h.val_offset != atteso.val_offset
+			|| h.file_size != atteso.file_size || atteso.file_size != length)
+		throw std::runtime_error(std::string("sparse_file: sezioni non valide o file troncato ") + filename);
+}
+
+/**
+ Verifica che i puntatori di riga partano da 0, non decrescano e finiscano a nnz,
+ come richiedono le ricerche binarie e i limiti di ogni riga
+
+ @param row_ptr righe + 1 puntatori di riga
+ @param righe numero di righe
+ @param nnz numero di elementi
+*/
+inline bool sparse_file_check_rows(const uint64_t* row_ptr, const int64_t righe, const uint64_t nnz) {
+	if (row_ptr[0] != 0 || row_ptr[righe] != nnz)
+		return false;
+	for (int64_t i = 0; i < righe; ++i)
+		if (row_ptr[i + 1] < row_ptr[i])
+			return false;
+	return true;
+}
+
+/**
+ Verifica che in ogni riga di [r0;r1) le colonne siano in [1;colonne] e strettamente crescenti
+
+ @param row_ptr puntatori di riga, gia' verificati
+ @param r0 prima riga (0-based)
+ @param r1 riga dopo l'ultima
+ @param cols indici di colonna a partire da quello in posizione row_ptr[r0]
+ @param colonne numero di colonne
+*/
+template <typename I>
+bool sparse_file_check_cols(const uint64_t* row_ptr, const int64_t r0, const int64_t r1, const I* cols, const int64_t colonne) {
+	const uint64_t k0 = row_ptr[r0];
+	for (int64_t i = r0; i < r1; ++i) {
+		int64_t precedente = 0;
+		for (uint64_t k = row_ptr[i] - k0; k < row_ptr[i + 1] - k0; ++k) {
+			const int64_t c = (int64_t)cols[k];
+			if (c <= precedente || c > colonne)
+				return false;
+			precedente = c;
+		}
+	}
+	return true;
+}
+
+/**
+ Salva una matrice nel formato binario nativo. Il tipo I degli indici di colonna
+ determina index_width e deve essere lo stesso usato da chi mappera' il file;
+ puo' essere diverso dal tipo Index della matrice, purche' contenga righe e colonne.
+
+ @param filename percorso del file
+ @param M matrice da salvare
+ @throw std::runtime_error se righe o colonne non entrano in I o il file non si puo' scrivere
+*/
+template <typename I, typename T, typename Index>
+void save_binary(const char* filename, const SparseMatrix<T, Index>& M) {
+	static_assert(std::is_trivially_copyable<T>::value, "il formato binario richiede un tipo T copiabile byte per byte");
+	sparse_file_header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, "SPMATRIX", 8);
+	h.version = SPARSE_FILE_VERSION;
+	h.byte_order = SPARSE_FILE_BYTE_ORDER;
+	h.index_width = sizeof(I);
+	h.value_size = sizeof(T);
+	h.righe = M.get_righe();
+	h.colonne = M.get_colonne();
+	h.nnz = M.get_size();
+	sparse_file_layout(h);
+
+	std::vector<uint64_t> row_ptr(M.get_righe() + 1, 0);
+	std::vector<I> cols;
+	std::vector<T> vals;
+	cols.reserve(M.get_size());
+	vals.reserve(M.get_size());
+	if ((uint64_t)M.get_righe() > (uint64_t)std::numeric_limits<I>::max()
+			|| (uint64_t)M.get_colonne() > (uint64_t)std::numeric_limits<I>::max())
+		throw std::runtime_error(std::string("save_binary: righe o colonne non entrano nel tipo degli indici per ") + filename);
+	typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+	for (; Ib != Ie; ++Ib) {
+		++row_ptr[(*Ib).riga];
+		cols.push_back((I)(*Ib).colonna);
+		vals.push_back((*Ib).dato);
+	}
+	for (Index i = 0; i < M.get_righe(); ++i)
+		row_ptr[i + 1] += row_ptr[i];
+
+	std::ofstream os(filename, std::ios::binary);
+	if (!os)
+		throw std::runtime_error(std::string("save_binary: impossibile aprire ") + filename);
+	const char zeros[SPARSE_FILE_ALIGN] = {0};
+	uint64_t pos = 0;
+	// scrive una sezione preceduta dal riempimento fino alla sua posizione
+	auto write_section = [&](const uint64_t offset, const void* data, const uint64_t len) {
+		os.write(zeros, offset - pos);
+		os.write((const char*)data, len);
+		pos = offset + len;
+	};
+	const T D = M.get_default();
+	write_section(0, &h, sizeof(h));
+	write_section(h.default_offset, &D, sizeof(T));
+	write_section(h.row_ptr_offset, row_ptr.data(), row_ptr.size() * sizeof(uint64_t));
+	write_section(h.col_offset, cols.data(), cols.size() * sizeof(I));
+	write_section(h.val_offset, vals.data(), vals.size() * sizeof(T));
+	if (!os)
+		throw std::runtime_error(std::string("save_binary: errore di scrittura su ") + filename);
+}
+
+/**
+ Vista in sola lettura su una matrice salvata con save_binary, mappata in memoria
+ con mmap. L'apertura costa O(1): nessun dato viene letto o copiato finche' non
+ serve, e piu' processi che mappano lo stesso file condividono la page cache.
+ Espone la stessa interfaccia di lettura di SparseMatrix (operator(), iteratori,
+ spmv). Il tipo I degli indici di colonna deve coincidere con quello del file ed
+ e' anche il tipo di righe e colonne esposto (come Index in SparseMatrix).
+ All'apertura vengono sempre verificati intestazione e puntatori di riga (O(righe));
+ le colonne (O(nnz)) solo se richiesto, altrimenti con verify() prima di fidarsi
+ di un file che potrebbe essere corrotto.
+
+ @brief matrice sparsa mappata da file binario
+*/
+template <typename T, typename I = int32_t> ///< T = tipo dei valori, I = tipo degli indici
+class MappedSparseMatrix {
+	static_assert(std::is_trivially_copyable<T>::value, "il formato binario richiede un tipo T copiabile byte per byte");
+
+	void* base; ///< inizio della mappatura
+	size_t length; ///< lunghezza della mappatura
+	I righe; ///< numero di righe
+	I colonne; ///< numero di colonne
+	uint64_t size; ///< numero di elementi memorizzati
+	const T* D; ///< dato di default, nel file
+	const uint64_t* row_ptr; ///< puntatori di riga, nel file
+	const I* cols; ///< indici di colonna (1-based), nel file
+	const T* vals; ///< valori, nel file
+
+	MappedSparseMatrix(const MappedSparseMatrix&); // non copiabile
+	MappedSparseMatrix& operator=(const MappedSparseMatrix&); // non assegnabile
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef typename SparseMatrix<T, I>::element element; ///< elemento esposto dall'iteratore
+
+	/**
+	 Costruttore, mappa il file e ne verifica intestazione e puntatori di riga
+
+	 @param filename percorso del file
+	 @param verifica_colonne se true verifica anche tutti gli indici di colonna, vedi verify()
+	 @throw std::runtime_error se il file non si apre, non e' compatibile o e' corrotto
+	*/
+	explicit MappedSparseMatrix(const char* filename, const bool verifica_colonne = true) : base(0), length(0) {
+		const int fd = ::open(filename, O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error(std::string("MappedSparseMatrix: impossibile aprire ") + filename);
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(sparse_file_header)) {
+			::close(fd);
+			throw std::runtime_error(std::string("MappedSparseMatrix: file troppo corto ") + filename);
+		}
+		length = (size_t)st.st_size;
+		base = ::mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (base == MAP_FAILED)
+			throw std::runtime_error(std::string("MappedSparseMatrix: mmap fallita su ") + filename);
+		try {
+			const sparse_file_header& h = *(const sparse_file_header*)base;
+			sparse_file_check_header(h, length, sizeof(I), sizeof(T), filename);
+			if ((uint64_t)h.righe > (uint64_t)std::numeric_limits<I>::max()
+					|| (uint64_t)h.colonne > (uint64_t)std::numeric_limits<I>::max())
+				throw std::runtime_error(std::string("MappedSparseMatrix: formato non compatibile ") + filename);
+			const char* b = (const char*)base;
+			righe = (I)h.righe;
+			colonne = (I)h.colonne;
+			size = h.nnz;
+			D = (const T*)(b + h.default_offset);
+			row_ptr = (const uint64_t*)(b + h.row_ptr_offset);
+			cols = (const I*)(b + h.col_offset);
+			vals = (const T*)(b + h.val_offset);
+			if (!sparse_file_check_rows(row_ptr, righe, size))
+				throw std::runtime_error(std::string("MappedSparseMatrix: puntatori di riga non validi in ") + filename);
+			if (verifica_colonne && !verify())
+				throw std::runtime_error(std::string("MappedSparseMatrix: indici di colonna non validi in ") + filename);
+		}
+		catch (...) {
+			::munmap(base, length);
+			throw;
+		}
+	}
+
+	/**
+	 Distruttore, rilascia la mappatura
+	*/
+	~MappedSparseMatrix() {
+		::munmap(base, length);
+	}
+
+	/**
+	 Verifica che ogni indice di colonna sia in [1;get_colonne()] e che le colonne
+	 di ogni riga siano strettamente crescenti. Legge tutto il file degli indici:
+	 va chiamato se il costruttore non l'ha gia' fatto e il file non e' fidato,
+	 prima di usare operator(), spmv o gli iteratori.
+
+	 @return true se il file e' valido
+	*/
+	bool verify() const {
+		return sparse_file_check_cols(row_ptr, 0, (int64_t)righe, cols, (int64_t)colonne);
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	uint64_t get_size() const {
+		return size;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	I get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	I get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return *D;
+	}
+
+	/**
+	 Ritorna il valore in (r;c), cercando la colonna con una ricerca binaria nella riga r
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const I r, const I c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		const I* first = cols + row_ptr[r - 1];
+		const I* last = cols + row_ptr[r];
+		const I* p = std::lower_bound(first, last, (I)c);
+		if (p != last && *p == (I)c)
+			return vals[p - cols];
+		return *D;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x calcolato direttamente sulle pagine mappate.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const default_correction<T> correzione(*D, x, colonne);
+		for (I i = 0; i < righe; ++i) {
+			T acc = zero;
+			T somma_memorizzati = zero;
+			for (uint64_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+				acc += vals[k] * x[cols[k] - 1];
+				if (correzione.active())
+					somma_memorizzati += x[cols[k] - 1];
+			}
+			y[i] = correzione(acc, somma_memorizzati);
+		}
+	}
+
+	/**
+	 Ritorna la riga (1-based) che contiene il k-esimo elemento, con una ricerca binaria
+
+	 @param k posizione, da 0 a get_size()
+	*/
+	I row_of(const uint64_t k) const {
+		const uint64_t* p = std::upper_bound(row_ptr, row_ptr + (uint64_t)righe + 1, k);
+		return (I)std::min<uint64_t>((uint64_t)(p - row_ptr), (uint64_t)righe);
+	}
+
+	/**
+	 Ritorna il k-esimo elemento memorizzato in ordine naturale; la riga si
+	 trova con una ricerca binaria sui puntatori di riga
+
+	 @param k posizione, da 0 a get_size() - 1
+	*/
+	element operator[](const uint64_t k) const {
+		assert(k < size);
+		return element(row_of(k), cols[k], vals[k]);
+	}
+
+	/**
+	 Iteratore costante ad accesso casuale, scorre gli elementi in ordine naturale
+	 e li ritorna per valore (nel file riga, colonna e dato non sono contigui).
+	 ++ e -- costano O(1) ammortizzato, i salti O(log righe) per ritrovare la riga.
+	*/
+	class const_iterator {
+		const MappedSparseMatrix* m;
+		uint64_t k; ///< posizione dell'elemento
+		I r; ///< riga dell'elemento
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef element reference;
+
+		const_iterator() : m(0), k(0), r(0) {}
+
+		// Ritorna l'elemento riferito dall'iteratore
+		reference operator*() const {
+			return element(r, m->cols[k], m->vals[k]);
+		}
+
+		// Ritorna l'elemento a distanza n dall'iteratore
+		reference operator[](const difference_type n) const {
+			return (*m)[k + n];
+		}
+
+		// Operatore di iterazione post-incremento
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		const_iterator& operator++() {
+			++k;
+			settle();
+			return *this;
+		}
+
+		// Operatore di iterazione post-decremento
+		const_iterator operator--(int) {
+			const_iterator tmp(*this);
+			--(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-decremento
+		const_iterator& operator--() {
+			--k;
+			while (r > 1 && m->row_ptr[r - 1] > k)
+				--r;
+			return *this;
+		}
+
+		// Avanza di n posizioni
+		const_iterator& operator+=(const difference_type n) {
+			k += n;
+			r = m->row_of(k);
+			return *this;
+		}
+
+		// Arretra di n posizioni
+		const_iterator& operator-=(const difference_type n) {
+			return *this += -n;
+		}
+
+		// Iteratore spostato di n posizioni in avanti
+		const_iterator operator+(const difference_type n) const {
+			const_iterator tmp(*this);
+			return tmp += n;
+		}
+
+		// Iteratore spostato di n posizioni all'indietro
+		const_iterator operator-(const difference_type n) const {
+			const_iterator tmp(*this);
+			return tmp -= n;
+		}
+
+		// Distanza tra due iteratori
+		difference_type operator-(const const_iterator &other) const {
+			return (difference_type)k - (difference_type)other.k;
+		}
+
+		// Iteratore spostato di n posizioni in avanti
+		friend const_iterator operator+(const difference_type n, const const_iterator &it) {
+			return it + n;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (k == other.k);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return (k != other.k);
+		}
+
+		// Ordinamento per posizione
+		bool operator<(const const_iterator &other) const {
+			return (k < other.k);
+		}
+
+		bool operator>(const const_iterator &other) const {
+			return (k > other.k);
+		}
+
+		bool operator<=(const const_iterator &other) const {
+			return (k <= other.k);
+		}
+
+		bool operator>=(const const_iterator &other) const {
+			return (k >= other.k);
+		}
+
+	private:
+		friend class MappedSparseMatrix;
+
+		// Costruttore privato di inizializzazione usato da begin e end
+		const_iterator(const MappedSparseMatrix* mm, const uint64_t kk, const I rr) : m(mm), k(kk), r(rr) {
+			settle();
+		}
+
+		// Porta r sulla riga che contiene la posizione k
+		void settle() {
+			while (r < m->righe && m->row_ptr[r] <= k)
+				++r;
+		}
+	}; // classe const_iterator
+
+	/**
+	 Ritorna l'iteratore costante all'inizio della sequenza dati
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0, 1);
+	}
+
+	/**
+	 Ritorna l'iteratore costante alla fine della sequenza dati
+	*/
+	const_iterator end() const {
+		return const_iterator(this, size, righe);
+	}
+};
+
+/**
+ Prodotto matrice-vettore su una matrice mappata
+
+ @param M matrice mappata
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename I>
+void spmv(const MappedSparseMatrix<T, I>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+/**
+ Legge esattamente len byte dalla posizione offset del file, ripetendo pread
+ finche' necessario.
+
+ @param fd descrittore del file
+ @param data destinazione
+ @param len byte da leggere
+ @param offset posizione nel file
+ @throw std::runtime_error in caso di errore o file troppo corto
+*/
+inline void sparse_file_read(const int fd, void* data, uint64_t len, uint64_t offset) {
+	char* p = (char*)data;
+	while (len > 0) {
+		const ssize_t n = ::pread(fd, p, len, (off_t)offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			throw std::runtime_error("sparse_file_read: lettura fallita");
+		p += n;
+		len -= (uint64_t)n;
+		offset += (uint64_t)n;
+	}
+}
+
+/**
+ Matrice salvata con save_binary ed elaborata fuori memoria: all'apertura vengono
+ letti solo intestazione e puntatori di riga, mentre indici e valori restano su
+ disco e vengono letti a blocchi di righe durante spmv. La lettura e' a doppio
+ buffer: mentre si calcola il prodotto su un blocco, un secondo thread legge con
+ pread il blocco successivo, cosi' calcolo e I/O si sovrappongono.
+ Adatta a matrici piu' grandi della RAM disponibile. I puntatori di riga sono
+ verificati all'apertura, gli indici di colonna di ogni blocco quando viene letto.
+
+ @brief matrice binaria elaborata a blocchi da disco
+*/
+template <typename T, typename I = int32_t> ///< T = tipo dei valori, I = tipo degli indici
+class StreamedSparseMatrix {
+	static_assert(std::is_trivially_copyable<T>::value, "il formato binario richiede un tipo T copiabile byte per byte");
+
+	/**
+	 Blocco di righe [r0;r1) caricato in memoria
+	*/
+	struct block {
+		int64_t r0; ///< prima riga (0-based)
+		int64_t r1; ///< riga successiva all'ultima
+		std::vector<I> cols; ///< indici di colonna del blocco
+		std::vector<T> vals; ///< valori del blocco
+	};
+
+	int fd; ///< descrittore del file
+	sparse_file_header h; ///< intestazione del file
+	T D; ///< dato di default
+	std::vector<uint64_t> row_ptr; ///< puntatori di riga, letti all'apertura
+	uint64_t block_nnz; ///< numero massimo di elementi per blocco
+
+	StreamedSparseMatrix(const StreamedSparseMatrix&); // non copiabile
+	StreamedSparseMatrix& operator=(const StreamedSparseMatrix&); // non assegnabile
+
+	/**
+	 Legge da disco indici e valori delle righe [b.r0;b.r1)
+
+	 @param b blocco da riempire
+	*/
+	void load(block& b) const {
+		const uint64_t k0 = row_ptr[b.r0];
+		const uint64_t n = row_ptr[b.r1] - k0;
+		b.cols.resize(n);
+		b.vals.resize(n);
+		sparse_file_read(fd, b.cols.data(), n * sizeof(I), h.col_offset + k0 * sizeof(I));
+		sparse_file_read(fd, b.vals.data(), n * sizeof(T), h.val_offset + k0 * sizeof(T));
+		if (!sparse_file_check_cols(row_ptr.data(), b.r0, b.r1, b.cols.data(), h.colonne))
+			throw std::runtime_error("StreamedSparseMatrix: indici di colonna non validi");
+	}
+
+public:
+	typedef T value_type; ///< tipo di dato
+
+	/**
+	 Costruttore, apre il file e ne legge intestazione e puntatori di riga
+
+	 @param filename percorso del file
+	 @param block_bytes memoria indicativa per ciascuno dei due buffer di lettura
+	 @throw std::runtime_error se il file non si apre o non e' compatibile
+	*/
+	explicit StreamedSparseMatrix(const char* filename, const uint64_t block_bytes = 64 << 20) : fd(-1) {
+		fd = ::open(filename, O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error(std::string("StreamedSparseMatrix: impossibile aprire ") + filename);
+		try {
+			struct stat st;
+			if (::fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(h))
+				throw std::runtime_error(std::string("StreamedSparseMatrix: file troppo corto ") + filename);
+			sparse_file_read(fd, &h, sizeof(h), 0);
+			sparse_file_check_header(h, (uint64_t)st.st_size, sizeof(I), sizeof(T), filename);
+			if ((uint64_t)h.righe > (uint64_t)std::numeric_limits<I>::max()
+					|| (uint64_t)h.colonne > (uint64_t)std::numeric_limits<I>::max())
+				throw std::runtime_error(std::string("StreamedSparseMatrix: formato non compatibile ") + filename);
+			sparse_file_read(fd, &D, sizeof(T), h.default_offset);
+			row_ptr.resize(h.righe + 1);
+			sparse_file_read(fd, row_ptr.data(), row_ptr.size() * sizeof(uint64_t), h.row_ptr_offset);
+			if (!sparse_file_check_rows(row_ptr.data(), h.righe, h.nnz))
+				throw std::runtime_error(std::string("StreamedSparseMatrix: puntatori di riga non validi in ") + filename);
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+		block_nnz = std::max<uint64_t>(1, block_bytes / (sizeof(I) + sizeof(T)));
+#ifdef POSIX_FADV_SEQUENTIAL
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	}
+
+	/**
+	 Distruttore, chiude il file
+	*/
+	~StreamedSparseMatrix() {
+		::close(fd);
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati
+	*/
+	uint64_t get_size() const {
+		return h.nnz;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	I get_righe() const {
+		return (I)h.righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	I get_colonne() const {
+		return (I)h.colonne;
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return D;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x leggendo la matrice a blocchi da disco,
+	 con la lettura del blocco successivo sovrapposta al calcolo. Ogni blocco
+	 contiene righe intere per circa block_bytes byte (almeno una riga).
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	 @throw std::runtime_error se una lettura fallisce, eccezione di allocazione di memoria
+	*/
+	void spmv(const T* x, T* y) const {
+		const int64_t righe = h.righe;
+		const T zero = T();
+		const default_correction<T> correzione(D, x, h.colonne);
+
+		block buf[2];
+		int corrente = 0;
+		buf[0].r0 = 0;
+		buf[0].r1 = next_block_end(0);
+		load(buf[0]);
+		while (buf[corrente].r0 < righe) {
+			block& b = buf[corrente];
+			block& succ = buf[1 - corrente];
+			succ.r0 = b.r1;
+			succ.r1 = (succ.r0 < righe) ? next_block_end(succ.r0) : righe;
+			std::exception_ptr errore;
+			std::thread lettore;
+			if (succ.r0 < righe) {
+				lettore = std::thread([&]() {
+					try {
+						load(succ);
+					}
+					catch (...) {
+						errore = std::current_exception();
+					}
+				});
+			}
+			const uint64_t k0 = row_ptr[b.r0];
+			for (int64_t i = b.r0; i < b.r1; ++i) {
+				T acc = zero;
+				T somma_memorizzati = zero;
+				for (uint64_t k = row_ptr[i] - k0; k < row_ptr[i + 1] - k0; ++k) {
+					acc += b.vals[k] * x[b.cols[k] - 1];
+					if (correzione.active())
+						somma_memorizzati += x[b.cols[k] - 1];
+				}
+				y[i] = correzione(acc, somma_memorizzati);
+			}
+			if (lettore.joinable())
+				lettore.join();
+			if (errore)
+				std::rethrow_exception(errore);
+			corrente = 1 - corrente;
+		}
+	}
+
+private:
+	/**
+	 Ritorna la riga (esclusa) con cui termina il blocco che inizia alla riga r0
+
+	 @param r0 prima riga del blocco (0-based)
+	*/
+	int64_t next_block_end(const int64_t r0) const {
+		const uint64_t limite = row_ptr[r0] + block_nnz;
+		const int64_t r1 = (int64_t)(std::upper_bound(row_ptr.begin() + r0 + 1, row_ptr.end(), limite) - row_ptr.begin()) - 1;
+		return std::max(r1, r0 + 1);
+	}
+};
+
+/**
+ Prodotto matrice-vettore fuori memoria
+
+ @param M matrice elaborata da disco
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename I>
+void spmv(const StreamedSparseMatrix<T, I>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
@@ -0,0 +1,396 @@
+#ifndef SPARSE_PATTERN_H
+#define SPARSE_PATTERN_H
+
+#include "SparseMatrix.h"
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ Matrice sparsa di sola struttura (booleana): memorizza solo quali caselle sono
+ presenti, senza valori ne' puntatori per elemento. Ogni riga e' un vettore
+ ordinato di colonne oppure, quando e' abbastanza piena da occupare meno spazio
+ cosi', un bitset di get_colonne() bit. Pensata per matrici di adiacenza, dove
+ SparseMatrix<bool> pagherebbe un dato e due puntatori per ogni arco.
+ Supporta l'iterazione in ordine naturale e le operazioni insiemistiche
+ (unione, intersezione, differenza) riga per riga.
+
+ @brief matrice sparsa booleana senza valori
+*/
+template <typename Index = int> ///< Index = tipo intero degli indici
+class SparsePattern {
+	/**
+	 Una riga: colonne ordinate se sparsa, bitset se densa (in quel caso cols e' vuoto)
+	*/
+	struct row {
+		std::vector<Index> cols; ///< colonne presenti, in ordine crescente
+		std::vector<uint64_t> bits; ///< bit c-1 acceso se la colonna c e' presente
+	};
+
+	Index righe; ///< numero di righe
+	Index colonne; ///< numero di colonne
+	size_t size; ///< numero di caselle presenti
+	std::vector<row> data; ///< righe della matrice
+
+	/**
+	 Numero di parole da 64 bit del bitset di una riga
+	*/
+	size_t words() const {
+		return ((size_t)colonne + 63) / 64;
+	}
+
+	/**
+	 Ritorna true se la colonna c e' nel bitset
+	*/
+	static bool test(const std::vector<uint64_t>& bits, const Index c) {
+		return (bits[(size_t)(c - 1) / 64] >> ((size_t)(c - 1) % 64)) & 1;
+	}
+
+	/**
+	 Accende il bit della colonna c
+	*/
+	static void set(std::vector<uint64_t>& bits, const Index c) {
+		bits[(size_t)(c - 1) / 64] |= (uint64_t)1 << ((size_t)(c - 1) % 64);
+	}
+
+	/**
+	 Ritorna il bitset della riga, convertendola se e' memorizzata come vettore
+	*/
+	std::vector<uint64_t> as_bits(const row& x) const {
+		if (!x.bits.empty())
+			return x.bits;
+		std::vector<uint64_t> b(words(), 0);
+		for (size_t k = 0; k < x.cols.size(); ++k)
+			set(b, x.cols[k]);
+		return b;
+	}
+
+	/**
+	 Numero di colonne presenti nella riga
+	*/
+	static size_t count(const row& x) {
+		if (x.bits.empty())
+			return x.cols.size();
+		size_t n = 0;
+		for (size_t w = 0; w < x.bits.size(); ++w)
+			n += (size_t)__builtin_popcountll(x.bits[w]);
+		return n;
+	}
+
+	/**
+	 Sceglie la rappresentazione piu' compatta per la riga: bitset se il vettore
+	 di colonne occuperebbe piu' spazio, vettore altrimenti
+
+	 @param x riga da normalizzare
+	 @param n numero di colonne presenti nella riga
+	*/
+	void normalize(row& x, const size_t n) const {
+		const bool densa = n * sizeof(Index) > words() * sizeof(uint64_t);
+		if (densa && x.bits.empty()) {
+			x.bits = as_bits(x);
+			std::vector<Index>().swap(x.cols);
+		}
+		else if (!densa && !x.bits.empty()) {
+			x.cols.clear();
+			x.cols.reserve(n);
+			for (size_t w = 0; w < x.bits.size(); ++w)
+				for (uint64_t b = x.bits[w]; b != 0; b &= b - 1)
+					x.cols.push_back((Index)(w * 64 + (size_t)__builtin_ctzll(b) + 1));
+			std::vector<uint64_t>().swap(x.bits);
+		}
+	}
+
+	/**
+	 Operazioni insiemistiche supportate da combine
+	*/
+	enum set_op {
+		op_union, ///< A | B
+		op_intersection, ///< A & B
+		op_difference ///< A - B
+	};
+
+	/**
+	 Combina riga per riga questa matrice con other
+
+	 @param other secondo operando, delle stesse dimensioni
+	 @param op operazione
+	 @return la matrice risultato
+	*/
+	SparsePattern combine(const SparsePattern& other, const set_op op) const {
+		assert(righe == other.righe && colonne == other.colonne);
+		SparsePattern res(righe, colonne);
+		for (Index i = 0; i < righe; ++i) {
+			const row& a = data[i];
+			const row& b = other.data[i];
+			row& out = res.data[i];
+			if (a.bits.empty() && b.bits.empty()) { // entrambe sparse: fusione dei vettori ordinati
+				if (op == op_union)
+					std::set_union(a.cols.begin(), a.cols.end(), b.cols.begin(), b.cols.end(), std::back_inserter(out.cols));
+				else if (op == op_intersection)
+					std::set_intersection(a.cols.begin(), a.cols.end(), b.cols.begin(), b.cols.end(), std::back_inserter(out.cols));
+				else
+					std::set_difference(a.cols.begin(), a.cols.end(), b.cols.begin(), b.cols.end(), std::back_inserter(out.cols));
+			}
+			else if (a.bits.empty() && op != op_union) { // a sparsa: filtro le sue colonne col bitset di b
+				for (size_t k = 0; k < a.cols.size(); ++k)
+					if (test(b.bits, a.cols[k]) == (op == op_intersection))
+						out.cols.push_back(a.cols[k]);
+			}
+			else { // almeno una densa: operazione parola per parola
+				out.bits = as_bits(a);
+				const std::vector<uint64_t> bb = as_bits(b);
+				for (size_t w = 0; w < out.bits.size(); ++w) {
+					if (op == op_union)
+						out.bits[w] |= bb[w];
+					else if (op == op_intersection)
+						out.bits[w] &= bb[w];
+					else
+						out.bits[w] &= ~bb[w];
+				}
+			}
+			const size_t n = count(out);
+			res.normalize(out, n);
+			res.size += n;
+		}
+		return res;
+	}
+
+public:
+	typedef Index index_type; ///< tipo degli indici
+
+	/**
+	 Posizione di una casella presente, esposta dall'iteratore
+	*/
+	struct element {
+		Index riga; ///< posizione riga
+		Index colonna; ///< posizione colonna
+	};
+
+	/**
+	 Costruttore di una matrice vuota
+
+	 @param r numero di righe
+	 @param c numero di colonne
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparsePattern(const Index r, const Index c) : righe(r), colonne(c), size(0), data((size_t)r) {
+		assert(r > 0);
+		assert(c > 0);
+	}
+
+	/**
+	 Costruttore che prende la struttura (le caselle memorizzate) di una SparseMatrix
+
+	 @param M matrice di cui copiare la struttura
+	 @throw eccezione di allocazione di memoria
+	*/
+	template <typename T>
+	explicit SparsePattern(const SparseMatrix<T, Index>& M) : righe(M.get_righe()), colonne(M.get_colonne()), size(M.get_size()), data((size_t)M.get_righe()) {
+		typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib)
+			data[(*Ib).riga - 1].cols.push_back((*Ib).colonna);
+		for (Index i = 0; i < righe; ++i)
+			normalize(data[i], data[i].cols.size());
+	}
+
+	/**
+	 Ritorna il numero di caselle presenti
+	*/
+	size_t get_size() const {
+		return size;
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return righe;
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return colonne;
+	}
+
+	/**
+	 Segna presente la casella (r;c). Se la riga diventa abbastanza piena passa al bitset.
+
+	 @param r riga
+	 @param c colonna
+	 @throw eccezione di allocazione di memoria
+	*/
+	void add(const Index r, const Index c) {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		row& x = data[r - 1];
+		if (!x.bits.empty()) {
+			if (!test(x.bits, c)) {
+				set(x.bits, c);
+				++size;
+			}
+			return;
+		}
+		typename std::vector<Index>::iterator p = std::lower_bound(x.cols.begin(), x.cols.end(), c);
+		if (p != x.cols.end() && *p == c)
+			return;
+		x.cols.insert(p, c);
+		++size;
+		normalize(x, x.cols.size());
+	}
+
+	/**
+	 Ritorna true se la casella (r;c) e' presente
+
+	 @param r riga
+	 @param c colonna
+	*/
+	bool operator()(const Index r, const Index c) const {
+		assert(r <= righe && r > 0);
+		assert(c <= colonne && c > 0);
+		const row& x = data[r - 1];
+		if (!x.bits.empty())
+			return test(x.bits, c);
+		return std::binary_search(x.cols.begin(), x.cols.end(), c);
+	}
+
+	/**
+	 Numero di caselle presenti nella riga r (il grado uscente per un grafo)
+
+	 @param r riga
+	*/
+	size_t row_size(const Index r) const {
+		assert(r <= righe && r > 0);
+		return count(data[r - 1]);
+	}
+
+	/**
+	 Unione: caselle presenti in almeno una delle due matrici
+	*/
+	SparsePattern operator|(const SparsePattern& other) const {
+		return combine(other, op_union);
+	}
+
+	/**
+	 Intersezione: caselle presenti in entrambe le matrici
+	*/
+	SparsePattern operator&(const SparsePattern& other) const {
+		return combine(other, op_intersection);
+	}
+
+	/**
+	 Differenza: caselle presenti in questa matrice ma non in other
+	*/
+	SparsePattern operator-(const SparsePattern& other) const {
+		return combine(other, op_difference);
+	}
+
+	/**
+	 Ritorna i byte occupati dalle righe
+	*/
+	size_t memory_bytes() const {
+		size_t n = data.size() * sizeof(row);
+		for (size_t i = 0; i < data.size(); ++i)
+			n += data[i].cols.capacity() * sizeof(Index) + data[i].bits.capacity() * sizeof(uint64_t);
+		return n;
+	}
+
+	/**
+	 Iteratore costante, scorre le caselle presenti in ordine naturale
+	*/
+	class const_iterator {
+		const SparsePattern* m;
+		Index r; ///< riga corrente (0-based)
+		size_t k; ///< posizione nel vettore, oppure bit nel bitset
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef element reference;
+
+		const_iterator() : m(0), r(0), k(0) {}
+
+		// Ritorna la casella riferita dall'iteratore
+		reference operator*() const {
+			element e;
+			e.riga = r + 1;
+			const row& x = m->data[r];
+			e.colonna = x.bits.empty() ? x.cols[k] : (Index)(k + 1);
+			return e;
+		}
+
+		// Operatore di iterazione post-incremento
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		const_iterator& operator++() {
+			++k;
+			settle();
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (r == other.r && k == other.k);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class SparsePattern;
+
+		// Costruttore privato di inizializzazione usato da begin e end
+		const_iterator(const SparsePattern* mm, const Index rr) : m(mm), r(rr), k(0) {
+			settle();
+		}
+
+		// Porta l'iteratore sulla prima casella presente a partire da (r;k)
+		void settle() {
+			while (r < m->righe) {
+				const row& x = m->data[r];
+				if (x.bits.empty()) {
+					if (k < x.cols.size())
+						return;
+				}
+				else {
+					for (size_t w = k / 64; w < x.bits.size(); ++w) {
+						uint64_t b = x.bits[w];
+						if (w == k / 64)
+							b &= ~(uint64_t)0 << (k % 64);
+						if (b != 0) {
+							k = w * 64 + (size_t)__builtin_ctzll(b);
+							return;
+						}
+					}
+				}
+				++r;
+				k = 0;
+			}
+		}
+	}; // classe const_iterator
+
+	/**
+	 Ritorna l'iteratore costante all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	/**
+	 Ritorna l'iteratore costante alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return const_iterator(this, righe);
+	}
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef SYMMETRIC_SPARSE_MATRIX_H
+#define SYMMETRIC_SPARSE_MATRIX_H
+
+#include "SparseMatrix.h"
+
+#include <stdexcept>
+#include <vector>
+
+/**
+ Matrice sparsa quadrata simmetrica che memorizza solo il triangolo superiore
+ (diagonale compresa) in una SparseMatrix. La casella (j;i) con j > i viene
+ letta da (i;j), quindi memoria e letture del prodotto matrice-vettore sono
+ circa la meta' rispetto a memorizzare entrambi i triangoli.
+
+ @brief matrice sparsa simmetrica a triangolo superiore
+*/
+template <typename T, typename Index = int> ///< T = tipo generico, Index = tipo intero degli indici
+class SymmetricSparseMatrix {
+	SparseMatrix<T, Index> upper; ///< triangolo superiore, riga <= colonna
+
+public:
+	typedef T value_type; ///< tipo di dato
+	typedef Index index_type; ///< tipo degli indici
+	typedef typename SparseMatrix<T, Index>::element element; ///< elemento della matrice
+
+	/**
+	 Costruttore di una matrice n x n vuota
+
+	 @param n numero di righe e di colonne
+	 @param d dato di default
+	 @throw eccezione di allocazione di memoria
+	*/
+	SymmetricSparseMatrix(const Index n, const T& d) : upper(n, n, d) {}
+
+	/**
+	 Costruttore a partire da una SparseMatrix quadrata. M puo' contenere solo il
+	 triangolo superiore, oppure entrambi: in quel caso deve essere simmetrica,
+	 cioe' ogni elemento (r;c) deve avere (c;r) uguale, altrimenti la conversione
+	 cambierebbe in silenzio i valori sotto la diagonale.
+
+	 @param M matrice quadrata
+	 @throw std::invalid_argument se M ha elementi sotto la diagonale e non e' simmetrica
+	 @throw eccezione di allocazione di memoria
+	*/
+	explicit SymmetricSparseMatrix(const SparseMatrix<T, Index>& M) : upper(M.get_righe(), M.get_colonne(), M.get_default()) {
+		assert(M.get_righe() == M.get_colonne());
+		std::vector<element> batch;
+		std::vector<element> specchio; // elementi sotto la diagonale, trasposti
+		typename SparseMatrix<T, Index>::const_iterator Ib = M.begin(), Ie = M.end();
+		for (; Ib != Ie; ++Ib) {
+			if ((*Ib).riga <= (*Ib).colonna)
+				batch.push_back(*Ib);
+			else
+				specchio.push_back(element((*Ib).colonna, (*Ib).riga, (*Ib).dato));
+		}
+		if (!specchio.empty()) {
+			// il triangolo inferiore trasposto, ordinato da scatter, deve coincidere con quello superiore
+			SparseMatrix<T, Index> trasposto(M.get_righe(), M.get_colonne(), M.get_default());
+			trasposto.scatter(specchio);
+			typename SparseMatrix<T, Index>::const_iterator Tb = trasposto.begin(), Te = trasposto.end();
+			for (size_t k = 0; k < batch.size(); ++k) {
+				if (batch[k].riga == batch[k].colonna)
+					continue;
+				if (Tb == Te || (*Tb).riga != batch[k].riga || (*Tb).colonna != batch[k].colonna || !((*Tb).dato == batch[k].dato))
+					throw std::invalid_argument("SymmetricSparseMatrix: la matrice non e' simmetrica");
+				++Tb;
+			}
+			if (Tb != Te)
+				throw std::invalid_argument("SymmetricSparseMatrix: la matrice non e' simmetrica");
+		}
+		upper.scatter(batch);
+	}
+
+	/**
+	 Ritorna il numero di elementi memorizzati (solo il triangolo superiore)
+	*/
+	size_t get_size() const {
+		return upper.get_size();
+	}
+
+	/**
+	 Getter per le righe
+	*/
+	Index get_righe() const {
+		return upper.get_righe();
+	}
+
+	/**
+	 Getter per le colonne
+	*/
+	Index get_colonne() const {
+		return upper.get_colonne();
+	}
+
+	/**
+	 Getter per il dato di default
+	*/
+	const T& get_default() const {
+		return upper.get_default();
+	}
+
+	/**
+	 Ritorna il triangolo superiore memorizzato
+	*/
+	const SparseMatrix<T, Index>& get_upper() const {
+		return upper;
+	}
+
+	/**
+	 Inserisce il valore in (r;c) e quindi anche in (c;r)
+
+	 @param r riga
+	 @param c colonna
+	 @param dato valore da inserire
+	 @throw eccezione di allocazione di memoria
+	*/
+	void add(const Index r, const Index c, const T& dato) {
+		if (r <= c)
+			upper.add(r, c, dato);
+		else
+			upper.add(c, r, dato);
+	}
+
+	/**
+	 Ritorna il valore in (r;c), letto dal triangolo superiore
+
+	 @param r riga
+	 @param c colonna
+	*/
+	const T& operator()(const Index r, const Index c) const {
+		return (r <= c) ? upper(r, c) : upper(c, r);
+	}
+
+	/**
+	 Ricostruisce la matrice completa con entrambi i triangoli
+
+	 @return la matrice a lista con gli elementi di entrambi i triangoli
+	 @throw eccezione di allocazione di memoria
+	*/
+	SparseMatrix<T, Index> expand() const {
+		SparseMatrix<T, Index> M(get_righe(), get_colonne(), get_default());
+		M.scatter(std::vector<element>(begin(), end()));
+		return M;
+	}
+
+	/**
+	 Prodotto matrice-vettore y = M * x che legge ogni elemento memorizzato una
+	 sola volta, usandolo per la riga e per la colonna.
+
+	 @param x vettore di get_colonne() elementi
+	 @param y vettore di get_righe() elementi
+	*/
+	void spmv(const T* x, T* y) const {
+		const T zero = T();
+		const Index n = get_righe();
+		const default_correction<T> correzione(get_default(), x, n);
+		std::vector<T> somma_memorizzati(correzione.active() ? (size_t)n : 0, zero);
+		for (Index i = 0; i < n; ++i)
+			y[i] = zero;
+		typename SparseMatrix<T, Index>::const_iterator Ib = upper.begin(), Ie = upper.end();
+		for (; Ib != Ie; ++Ib) {
+			const Index i = (*Ib).riga - 1;
+			const Index j = (*Ib).colonna - 1;
+			y[i] += (*Ib).dato * x[j];
+			if (correzione.active())
+				somma_memorizzati[i] += x[j];
+			if (i != j) {
+				y[j] += (*Ib).dato * x[i];
+				if (correzione.active())
+					somma_memorizzati[j] += x[i];
+			}
+		}
+		if (correzione.active())
+			for (Index i = 0; i < n; ++i)
+				y[i] = correzione(y[i], somma_memorizzati[i]);
+	}
+
+	/**
+	 Iteratore costante sulla matrice logica completa: per ogni elemento
+	 memorizzato (i;j) restituisce (i;j) e, se fuori dalla diagonale, subito
+	 dopo (j;i). L'ordine quindi non e' quello naturale; per averlo usare expand().
+	 Gli elementi sono restituiti per valore.
+	*/
+	class const_iterator {
+		typename SparseMatrix<T, Index>::const_iterator it;
+		bool specchio; ///< true se si sta restituendo (j;i)
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef element value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const element* pointer;
+		typedef element reference;
+
+		const_iterator() : specchio(false) {}
+
+		// Ritorna l'elemento riferito dall'iteratore
+		reference operator*() const {
+			if (specchio)
+				return element((*it).colonna, (*it).riga, (*it).dato);
+			return *it;
+		}
+
+		// Operatore di iterazione post-incremento
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		const_iterator& operator++() {
+			if (!specchio && (*it).riga != (*it).colonna)
+				specchio = true;
+			else {
+				specchio = false;
+				++it;
+			}
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (it == other.it && specchio == other.specchio);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class SymmetricSparseMatrix;
+
+		// Costruttore privato di inizializzazione usato da begin e end
+		explicit const_iterator(const typename SparseMatrix<T, Index>::const_iterator& i) : it(i), specchio(false) {}
+	}; // classe const_iterator
+
+	/**
+	 Ritorna l'iteratore costante all'inizio della matrice logica
+	*/
+	const_iterator begin() const {
+		return const_iterator(upper.begin());
+	}
+
+	/**
+	 Ritorna l'iteratore costante alla fine della matrice logica
+	*/
+	const_iterator end() const {
+		return const_iterator(upper.end());
+	}
+};
+
+/**
+ Versione di evaluate per SymmetricSparseMatrix: ogni elemento fuori dalla
+ diagonale conta per due caselle, le caselle di default con un'unica valutazione.
+
+ @param M matrice simmetrica di tipo T
+ @param p predicato
+*/
+template <typename T, typename Index, typename P>
+size_t evaluate(const SymmetricSparseMatrix<T, Index>& M, P& p) {
+	size_t counter = 0;
+	size_t logiche = 0;
+	typename SparseMatrix<T, Index>::const_iterator Ib = M.get_upper().begin(), Ie = M.get_upper().end();
+	for (; Ib != Ie; ++Ib) {
+		const size_t molteplicita = ((*Ib).riga == (*Ib).colonna) ? 1 : 2;
+		logiche += molteplicita;
+		if (p((*Ib).dato))
+			counter += molteplicita;
+	}
+	T D = M.get_default();
+	if (p(D))
+		counter += (size_t)M.get_righe() * (size_t)M.get_colonne() - logiche;
+	return counter;
+}
+
+/**
+ Prodotto matrice-vettore simmetrico
+
+ @param M matrice simmetrica
+ @param x vettore di M.get_colonne() elementi
+ @param y vettore di M.get_righe() elementi
+*/
+template <typename T, typename Index>
+void spmv(const SymmetricSparseMatrix<T, Index>& M, const T* x, T* y) {
+	M.spmv(x, y);
+}
+
+#endif
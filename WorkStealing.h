@@ -0,0 +1,364 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/**
+ Intervallo di compiti [lo;hi) di un thread. Il proprietario prende i compiti
+ dall'inizio, un ladro ruba la meta' finale.
+*/
+struct work_range {
+	std::mutex lock; ///< protegge lo e hi
+	size_t lo; ///< primo compito non ancora preso
+	size_t hi; ///< fine dei compiti del thread
+
+	work_range() : lo(0), hi(0) {}
+};
+
+/**
+ Prende il prossimo compito dal proprio intervallo
+
+ @param mio intervallo del thread
+ @param k compito preso
+ @return false se l'intervallo e' vuoto
+*/
+inline bool work_take(work_range& mio, size_t& k) {
+	std::lock_guard<std::mutex> guard(mio.lock);
+	if (mio.lo >= mio.hi)
+		return false;
+	k = mio.lo++;
+	return true;
+}
+
+/**
+ Ruba la meta' finale dei compiti rimasti a un altro thread e li mette nel
+ proprio intervallo, tenendo il primo da eseguire subito
+
+ @param vittima intervallo da cui rubare
+ @param mio intervallo del ladro, vuoto
+ @param k compito preso
+ @return false se la vittima non ha compiti
+*/
+inline bool work_steal(work_range& vittima, work_range& mio, size_t& k) {
+	size_t lo, hi;
+	{
+		std::lock_guard<std::mutex> guard(vittima.lock);
+		if (vittima.lo >= vittima.hi)
+			return false;
+		lo = vittima.lo + (vittima.hi - vittima.lo) / 2; // con un solo compito rimasto lo prende il ladro
+		hi = vittima.hi;
+		vittima.hi = lo;
+	}
+	std::lock_guard<std::mutex> guard(mio.lock);
+	mio.lo = lo + 1;
+	mio.hi = hi;
+	k = lo;
+	return true;
+}
+
+/**
+ Ritorna in quanti compiti dividere un lavoro per threads thread: alcuni per
+ thread, cosi' il furto di lavoro ha margine per bilanciare compiti di costo diverso
+
+ @param threads numero di thread, 0 per usarne uno per core
+*/
+inline size_t work_tasks(unsigned threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	return (size_t)threads * 8;
+}
+
+/**
+ Pool di thread persistente: i thread vengono creati una volta sola e fra un
+ lavoro e l'altro dormono su una variabile di condizione, quindi un lavoro
+ parallelo costa un risveglio e non la creazione e la join di un thread per
+ ogni chiamata. Chi lancia un lavoro con run() partecipa come thread 0.
+ I lavori lanciati da thread diversi vengono eseguiti uno alla volta; un
+ lavoro lanciato da dentro un altro lavoro del pool viene eseguito in modo
+ sequenziale dal thread che lo lancia.
+
+ @brief pool di thread persistente con furto di lavoro
+*/
+class work_pool {
+	/**
+	 Lavoro di furto su [0;n) con un intervallo per thread
+	*/
+	template <typename F>
+	struct job {
+		work_range* ranges; ///< intervalli dei thread
+		unsigned threads; ///< thread partecipanti
+		F* f; ///< funtore chiamato con l'indice del compito
+
+		// Ciclo di un thread: prima il proprio intervallo, poi i furti
+		static void esegui(void* c, const unsigned t) {
+			const job& j = *static_cast<const job*>(c);
+			size_t k;
+			for (;;) {
+				if (work_take(j.ranges[t], k)) {
+					(*j.f)(k);
+					continue;
+				}
+				bool rubato = false;
+				for (unsigned v = 1; v < j.threads && !rubato; ++v)
+					rubato = work_steal(j.ranges[(t + v) % j.threads], j.ranges[t], k);
+				if (!rubato)
+					return;
+				(*j.f)(k);
+			}
+		}
+	};
+
+	/**
+	 Lavoro che chiama f(w) una volta su ogni worker w
+	*/
+	template <typename F>
+	struct each {
+		F* f; ///< funtore chiamato con l'indice del worker
+
+		static void esegui(void* c, const unsigned w) {
+			(*static_cast<const each*>(c)->f)(w);
+		}
+	};
+
+	std::vector<std::thread> workers; ///< thread del pool
+	std::unique_ptr<work_range[]> ranges; ///< intervalli di run(), uno per partecipante
+	unsigned n_ranges; ///< numero di intervalli allocati
+	std::mutex uso; ///< serializza i lavori lanciati da thread diversi
+	std::mutex lock; ///< protegge lo stato del lavoro corrente
+	std::condition_variable cv_lavoro; ///< segnala un nuovo lavoro o la chiusura
+	std::condition_variable cv_fine; ///< segnala la fine del lavoro ai chiamanti
+	uint64_t generazione; ///< numero del lavoro corrente
+	void (*fn)(void*, unsigned); ///< funzione del lavoro corrente
+	void* ctx; ///< argomento di fn
+	unsigned quanti; ///< partecipanti al lavoro corrente
+	unsigned primo; ///< indice del partecipante eseguito dal worker 0
+	unsigned mancanti; ///< worker che non hanno ancora finito il lavoro corrente
+	std::vector<std::exception_ptr> errori; ///< eccezioni dei partecipanti
+	bool fine; ///< true quando il pool viene distrutto
+
+	work_pool(const work_pool&); // non copiabile
+	work_pool& operator=(const work_pool&);
+
+	/**
+	 Ritorna true se il thread chiamante sta eseguendo un lavoro del pool
+	*/
+	static bool& inside() {
+		static thread_local bool dentro = false;
+		return dentro;
+	}
+
+	/**
+	 Ciclo del worker w, creato quando il lavoro corrente era visto: attende un
+	 lavoro, esegue la sua parte e segnala la fine
+	*/
+	void worker(const unsigned w, uint64_t visto) {
+		inside() = true;
+		std::unique_lock<std::mutex> l(lock);
+		for (;;) {
+			cv_lavoro.wait(l, [&]() { return fine || generazione != visto; });
+			if (fine)
+				return;
+			visto = generazione;
+			const unsigned id = w + primo;
+			if (id >= quanti)
+				continue;
+			l.unlock();
+			try {
+				fn(ctx, id);
+			}
+			catch (...) {
+				errori[id] = std::current_exception();
+			}
+			l.lock();
+			if (--mancanti == 0)
+				cv_fine.notify_all();
+		}
+	}
+
+	/**
+	 Esegue fn(c, id) per id in [0;q): il chiamante esegue id 0 se chiamante e'
+	 true, il worker w esegue id w + (chiamante ? 1 : 0). Ritorna quando tutti
+	 hanno finito. Va chiamato con uso preso.
+
+	 @throw la prima eccezione lanciata da fn, dopo che tutti hanno finito
+	*/
+	void dispatch(const unsigned q, void (*f)(void*, unsigned), void* c, const bool chiamante) {
+		{
+			std::lock_guard<std::mutex> l(lock);
+			fn = f;
+			ctx = c;
+			quanti = q;
+			primo = chiamante ? 1 : 0;
+			mancanti = q - primo;
+			errori.assign(q, std::exception_ptr());
+			++generazione;
+		}
+		cv_lavoro.notify_all();
+		if (chiamante) {
+			inside() = true;
+			try {
+				f(c, 0);
+			}
+			catch (...) {
+				errori[0] = std::current_exception();
+			}
+			inside() = false;
+		}
+		std::unique_lock<std::mutex> l(lock);
+		cv_fine.wait(l, [&]() { return mancanti == 0; });
+		for (unsigned t = 0; t < q; ++t)
+			if (errori[t])
+				std::rethrow_exception(errori[t]);
+	}
+
+	/**
+	 Porta i worker ad almeno n, con un intervallo di run() per ciascuno e per
+	 il chiamante. Va chiamato con uso preso, quindi senza lavori in corso.
+
+	 @throw eccezione di allocazione di memoria o di creazione dei thread
+	*/
+	void grow(const unsigned n) {
+		if (n_ranges < n + 1) {
+			ranges.reset(new work_range[n + 1]);
+			n_ranges = n + 1;
+		}
+		while (workers.size() < n)
+			workers.push_back(std::thread(&work_pool::worker, this, (unsigned)workers.size(), generazione));
+	}
+
+	/**
+	 Ferma i thread avviati e li attende
+	*/
+	void stop() {
+		{
+			std::lock_guard<std::mutex> l(lock);
+			fine = true;
+		}
+		cv_lavoro.notify_all();
+		for (size_t w = 0; w < workers.size(); ++w)
+			if (workers[w].joinable())
+				workers[w].join();
+	}
+
+public:
+	/**
+	 Costruttore, avvia i thread
+
+	 @param n numero di worker
+	 @throw eccezione di allocazione di memoria o di creazione dei thread
+	*/
+	explicit work_pool(const unsigned n) : n_ranges(0), generazione(0), fn(0), ctx(0),
+			quanti(0), primo(0), mancanti(0), fine(false) {
+		try {
+			grow(n);
+		}
+		catch (...) {
+			stop();
+			throw;
+		}
+	}
+
+	/**
+	 Distruttore, ferma e attende i thread
+	*/
+	~work_pool() {
+		stop();
+	}
+
+	/**
+	 Ritorna il numero di worker
+	*/
+	unsigned size() {
+		std::lock_guard<std::mutex> u(uso);
+		return (unsigned)workers.size();
+	}
+
+	/**
+	 Pool condiviso usato da parallel_for, con un worker per core oltre al
+	 chiamante; viene creato alla prima chiamata e cresce se un lavoro chiede
+	 piu' thread
+	*/
+	static work_pool& global() {
+		static work_pool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+		return pool;
+	}
+
+	/**
+	 Esegue f(k) per ogni compito k in [0;n) con furto di lavoro: ogni
+	 partecipante parte da un intervallo contiguo di compiti e, finito il suo,
+	 ruba la meta' dei compiti rimasti a un altro.
+
+	 @param n numero di compiti
+	 @param f funtore chiamato con l'indice del compito
+	 @param threads partecipanti, chiamante compreso, 0 per usarne uno per core;
+	 se sono piu' di size() + 1 il pool crea i worker mancanti
+	 @throw la prima eccezione lanciata da f, dopo che tutti hanno finito
+	*/
+	template <typename F>
+	void run(const size_t n, F& f, unsigned threads) {
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		if (threads > n)
+			threads = (unsigned)n;
+		if (threads <= 1 || inside()) {
+			for (size_t k = 0; k < n; ++k)
+				f(k);
+			return;
+		}
+		std::lock_guard<std::mutex> u(uso);
+		grow(threads - 1);
+		for (unsigned t = 0; t < threads; ++t) {
+			ranges[t].lo = n * t / threads;
+			ranges[t].hi = n * (t + 1) / threads;
+		}
+		job<F> j = {ranges.get(), threads, &f};
+		dispatch(threads, &job<F>::esegui, &j, true);
+	}
+
+	/**
+	 Chiama f(w) una volta per ogni worker w in [0;size()), ciascuna sul thread
+	 del worker w, e attende che abbiano finito. Il worker w e' sempre lo stesso
+	 thread, quindi cio' che f fa al thread (per esempio fissarlo a una CPU)
+	 resta valido per i lavori successivi. Non va chiamato da un worker dello
+	 stesso pool.
+
+	 @param f funtore chiamato con l'indice del worker
+	 @throw la prima eccezione lanciata da f, dopo che tutti hanno finito
+	*/
+	template <typename F>
+	void run_each(F& f) {
+		std::lock_guard<std::mutex> u(uso);
+		if (workers.empty())
+			return;
+		each<F> j = {&f};
+		dispatch((unsigned)workers.size(), &each<F>::esegui, &j, false);
+	}
+};
+
+/**
+ Esegue f(k) per ogni compito k in [0;n) con threads thread e bilanciamento per
+ furto di lavoro, sul pool condiviso work_pool::global(): ogni thread parte da
+ un intervallo contiguo di compiti e, finito il suo, ruba la meta' dei compiti
+ rimasti a un altro thread. Con compiti di costo molto diverso (righe con molti
+ piu' elementi delle altre) i thread restano occupati finche' c'e' lavoro.
+ f deve poter essere chiamata da piu' thread contemporaneamente su compiti
+ diversi. I thread del pool vengono riusati fra le chiamate.
+
+ @param n numero di compiti
+ @param f funtore chiamato con l'indice del compito
+ @param threads numero di thread, 0 per usarne uno per core
+ @throw la prima eccezione lanciata da f, dopo che tutti i thread hanno finito
+*/
+template <typename F>
+void parallel_for(const size_t n, F f, unsigned threads = 0) {
+	work_pool::global().run(n, f, threads);
+}
+
+#endif
@@ -1,7 +1,39 @@
 #include "SparseMatrix.h"
+#include "MatrixMarket.h"
+#include "SparseMatrixFile.h"
+#include "CompressedSparseMatrix.h"
+#include "SoASparseMatrix.h"
+#include "SparsePattern.h"
+#include "SymmetricSparseMatrix.h"
+#include "DiaSparseMatrix.h"
+#include "HybSparseMatrix.h"
+#include "AutoSparseMatrix.h"
+#include "SnapshotSparseMatrix.h"
+#include "ConcurrentSparseMatrix.h"
+#include "ShardedSparseMatrix.h"
+#include "NumaSparseMatrix.h"
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+#include <stdint.h>
+#include <thread>
+
+/**
+ Confronto tra un elemento e una riga, per cercare l'inizio di una riga con std::lower_bound.
+*/
+struct riga_minore {
+	template <typename E>
+	bool operator()(const E& e, const int r) const {
+		return e.riga < r;
+	}
+};
 
 /**
  Funtore che verifica la divisibilita' per 3.
@@ -56,6 +88,412 @@ int main() {
 #ifdef DEBUG
 	I.print();
 #endif
+	// test directory delle righe: inserimento in una riga vuota tra righe non vuote
+	SparseMatrix<int> R(5, 5, 0);
+	R.add(5, 1, 51);
+	R.add(1, 3, 13);
+	R.add(3, 2, 32);
+	R.add(3, 5, 35);
+	R.add(3, 1, 31);
+	std::cout << "Righe (3;1) (3;2) (5;1): " << R(3, 1) << " " << R(3, 2) << " " << R(5, 1) << " vuota: " << R(4, 4) << std::endl;
+	// riempimento dal basso di una matrice alta e quasi vuota: ogni riga nuova cerca la successiva non vuota
+	{
+		SparseMatrix<int> alta(1000000, 3, 0);
+		for (int r = 1000000; r > 0; r -= 7)
+			alta.add(r, 1 + r % 3, r);
+		int precedente = 0;
+		bool ordinata = true;
+		for (SparseMatrix<int>::const_iterator it = alta.begin(); it != alta.end(); ++it) {
+			ordinata = ordinata && (*it).riga > precedente;
+			precedente = (*it).riga;
+		}
+		std::cout << "Matrice alta dal basso size: " << alta.get_size() << " ordinata: " << ordinata << " (1000000;2): " << alta(1000000, 2) << std::endl;
+	}
+	
+	// test finger: letture in avanti e all'indietro sulla stessa riga
+	std::cout << "Riga 3 all'indietro: " << R(3, 5) << " " << R(3, 4) << " " << R(3, 2) << " " << R(3, 1) << std::endl;
+	
+	// test gather
+	int q_rows[] = {5, 3, 1, 3, 4};
+	int q_cols[] = {1, 5, 3, 1, 4};
+	int q_out[5];
+	R.gather(q_rows, q_cols, q_out, 5);
+	std::cout << "gather:";
+	for (int k = 0; k < 5; ++k)
+		std::cout << " " << q_out[k];
+	std::cout << std::endl;
+	
+	// test scatter
+	std::vector<SparseMatrix<int>::element> batch;
+	batch.push_back(SparseMatrix<int>::element(3, 2, 100));
+	batch.push_back(SparseMatrix<int>::element(2, 2, 22));
+	batch.push_back(SparseMatrix<int>::element(3, 2, 1));
+	R.scatter(batch, SparseMatrix<int>::accumulate);
+	std::cout << "scatter accumulate (3;2) (2;2): " << R(3, 2) << " " << R(2, 2) << std::endl;
+	R.scatter(batch, SparseMatrix<int>::keep_min);
+	std::cout << "scatter keep_min (3;2) (2;2): " << R(3, 2) << " " << R(2, 2) << std::endl;
+	std::vector<SparseMatrix<int>::element> annulla;
+	annulla.push_back(SparseMatrix<int>::element(2, 2, -22));
+	const size_t prima = R.get_size();
+	R.scatter(annulla, SparseMatrix<int>::accumulate); // (2;2) torna al default e viene rimosso
+	std::cout << "scatter accumulate a zero (2;2) size: " << R(2, 2) << " " << prima << "->" << R.get_size();
+	R.scatter(batch, SparseMatrix<int>::replace); // ripristina (2;2) nella riga tornata vuota
+	std::cout << " ripristino (2;2) size: " << R(2, 2) << " " << R.get_size() << std::endl;
+	
+	// test viste
+	SparseMatrix<int>::view rv = R.row_view(3);
+	for (SparseMatrix<int>::view::iterator it = rv.begin(); it != rv.end(); ++it)
+		(*it).dato *= 2;
+	std::cout << "row_view(3) raddoppiata:";
+	for (SparseMatrix<int>::view::iterator it = rv.begin(); it != rv.end(); ++it)
+		std::cout << " (" << it->riga << ";" << it->colonna << ")=" << it->dato;
+	std::cout << std::endl;
+	const SparseMatrix<int>& CR = R;
+	SparseMatrix<int>::const_view sv = CR.submatrix_view(2, 5, 1, 2);
+	std::cout << "submatrix_view [2;5]x[1;2]:";
+	for (SparseMatrix<int>::const_view::iterator it = sv.begin(); it != sv.end(); ++it)
+		std::cout << " " << it->dato;
+	std::cout << " vuota [4;4]: " << CR.rows_view(4, 4).empty() << std::endl;
+	
+	// test Matrix Market
+	std::stringstream mtx;
+	write_mtx(mtx, R);
+	SparseMatrix<int> RM = read_mtx<int>(mtx);
+	std::cout << "mtx rilettura (3;1) (5;1) size: " << RM(3, 1) << " " << RM(5, 1) << " " << RM.get_size() << std::endl;
+	std::stringstream sym("%%MatrixMarket matrix coordinate pattern symmetric\n% commento\n3 3 2\n2 1\n3 3\n");
+	SparseMatrix<double> SM = read_mtx<double>(sym);
+	std::cout << "mtx simmetrica (1;2) (2;1) (3;3) size: " << SM(1, 2) << " " << SM(2, 1) << " " << SM(3, 3) << " " << SM.get_size() << std::endl;
+	std::stringstream csv("1,2,3.5\n2,1,4\n3,3,1\n");
+	SparseMatrix<double> CM = read_triplets<double>(csv, 3, 3, 2);
+	std::cout << "triplette CSV con 2 thread (1;2) (2;1) size: " << CM(1, 2) << " " << CM(2, 1) << " " << CM.get_size() << std::endl;
+	const char* malformati[] = {
+		"%%MatrixMarket matrix coordinate real general\n3 3 1\n1,2,3.5\n", // virgole in un .mtx
+		"%%MatrixMarket matrix coordinate real general\n3 3 1\n1 2 3.5 x\n", // testo in eccesso
+		"%%MatrixMarket matrix coordinate pattern general\n3 3 1\n1 2 3.5\n", // valore in un pattern
+		"%%MatrixMarket matrix coordinate real general\n3 3 1 7\n1 2 3.5\n" // dimensioni in eccesso
+	};
+	std::cout << "mtx malformati rifiutati:";
+	for (int k = 0; k < 4; ++k) {
+		std::stringstream bad(malformati[k]);
+		try {
+			read_mtx<double>(bad);
+			std::cout << " no";
+		}
+		catch (const std::runtime_error&) {
+			std::cout << " si";
+		}
+	}
+	std::cout << std::endl;
+	
+	// test formato binario e mmap
+	save_binary<int>("matrice_test.bin", R);
+	{
+		MappedSparseMatrix<int> MR("matrice_test.bin");
+		std::cout << "mmap (3;1) (1;3) (4;4) size:" << " " << MR(3, 1) << " " << MR(1, 3) << " " << MR(4, 4) << " " << MR.get_size() << std::endl;
+		int x[5] = {1, 1, 1, 1, 1};
+		int y_lista[5], y_mmap[5];
+		spmv(R, x, y_lista);
+		spmv(MR, x, y_mmap);
+		std::cout << "spmv lista / mmap:";
+		for (int k = 0; k < 5; ++k)
+			std::cout << " " << y_lista[k] << "/" << y_mmap[k];
+		std::cout << std::endl;
+		std::cout << "iteratore mmap:";
+		for (MappedSparseMatrix<int>::const_iterator it = MR.begin(); it != MR.end(); ++it)
+			std::cout << " (" << (*it).riga << ";" << (*it).colonna << ")=" << (*it).dato;
+		std::cout << std::endl;
+		MappedSparseMatrix<int>::const_iterator ultimo = MR.end() - 1;
+		std::cout << "accesso casuale mmap: MR[2] riga " << MR[2].riga << " ultimo (" << (*ultimo).riga << ";" << (*ultimo).colonna
+			<< ") distanza " << std::distance(MR.begin(), MR.end()) << std::endl;
+	}
+	{
+		StreamedSparseMatrix<int> SR("matrice_test.bin", 16); // blocchi da circa due elementi
+		int x[5] = {1, 1, 1, 1, 1};
+		int y[5];
+		spmv(SR, x, y);
+		std::cout << "spmv fuori memoria:";
+		for (int k = 0; k < 5; ++k)
+			std::cout << " " << y[k];
+		std::cout << std::endl;
+	}
+	{ // file corrotti o scritti da una macchina con altro ordine dei byte: mmap e lettura a blocchi li rifiutano
+		std::ifstream in("matrice_test.bin", std::ios::binary);
+		std::vector<char> originale((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		in.close();
+		sparse_file_header h;
+		std::memcpy(&h, originale.data(), sizeof(h));
+		std::cout << "binari corrotti rifiutati mmap/blocchi:";
+		for (int k = 0; k < 3; ++k) {
+			std::vector<char> guasto(originale);
+			if (k == 0) { // marcatore letto da una macchina con ordine dei byte opposto
+				const uint32_t bo = 0x04030201;
+				std::memcpy(&guasto[offsetof(sparse_file_header, byte_order)], &bo, sizeof(bo));
+			}
+			else if (k == 1) { // row_ptr[1] = nnz, oltre row_ptr[2]: puntatori non monotoni
+				const uint64_t p = h.nnz;
+				std::memcpy(&guasto[h.row_ptr_offset + sizeof(uint64_t)], &p, sizeof(p));
+			}
+			else { // prima colonna fuori dalla matrice
+				const int c = R.get_colonne() + 1;
+				std::memcpy(&guasto[h.col_offset], &c, sizeof(c));
+			}
+			std::ofstream out("matrice_test.bin", std::ios::binary);
+			out.write(guasto.data(), guasto.size());
+			out.close();
+			try {
+				MappedSparseMatrix<int> MR("matrice_test.bin");
+				std::cout << " no";
+			}
+			catch (const std::runtime_error&) {
+				std::cout << " si";
+			}
+			try {
+				StreamedSparseMatrix<int> SR("matrice_test.bin");
+				int x[5] = {1, 1, 1, 1, 1};
+				int y[5];
+				spmv(SR, x, y); // le colonne di un blocco sono verificate quando viene letto
+				std::cout << "/no";
+			}
+			catch (const std::runtime_error&) {
+				std::cout << "/si";
+			}
+		}
+		try {
+			save_binary<uint8_t>("matrice_test.bin", SparseMatrix<int>(2, 300, 0));
+			std::cout << " colonne oltre uint8_t: no" << std::endl;
+		}
+		catch (const std::runtime_error&) {
+			std::cout << " colonne oltre uint8_t: si" << std::endl;
+		}
+	}
+	std::remove("matrice_test.bin");
+	
+	// test indici compressi
+	CompressedSparseMatrix<int> ZR(R);
+	{
+		int x[5] = {1, 1, 1, 1, 1};
+		int y[5];
+		spmv(ZR, x, y);
+		std::cout << "compressa (3;5) (4;4) spmv:" << " " << ZR(3, 5) << " " << ZR(4, 4) << " |";
+		for (int k = 0; k < 5; ++k)
+			std::cout << " " << y[k];
+		std::cout << " decompressa size: " << ZR.decompress().get_size() << std::endl;
+	}
+	{
+		SparseMatrix<int, int64_t> larga(2, 5000000000LL, 0);
+		larga.add(1, 4999999999LL, 7);
+		bool rifiutata = false;
+		try {
+			CompressedSparseMatrix<int, int64_t> ZL(larga);
+		}
+		catch (const std::length_error&) {
+			rifiutata = true;
+		}
+		std::cout << "compressa con colonne oltre 32 bit rifiutata: " << (rifiutata ? "si" : "no") << std::endl;
+	}
+	
+	// test tipo degli indici
+	SparseMatrix<float, uint16_t> tile(65535, 65535, 0.0f);
+	tile.add(65535, 65535, 1.5f);
+	tile.add(1, 65535, 2.5f);
+	SparseMatrix<double, int64_t> grande(1000, 3000000000LL, 0.0); // la directory delle righe occupa un puntatore per riga
+	grande.add(7, 2999999999LL, 4.5);
+	SparseMatrix<double> da_tile(tile);
+	std::cout << "indici uint16_t (65535;65535) size: " << tile(65535, 65535) << " " << tile.get_size()
+		<< " int64_t (7;2999999999): " << grande(7, 2999999999LL)
+		<< " conversione: " << da_tile(1, 65535) << std::endl;
+	
+	// test disposizione SoA
+	SoASparseMatrix<int> AR(R);
+	divis_per_3<int> div3;
+	std::cout << "SoA evaluate divis_per_3 su R: " << evaluate(AR, div3) << " (lista: " << evaluate(R, div3) << ")";
+	AR.scale(2);
+	std::cout << " dopo scale(2) somma: " << AR.sum_values() << " (3;2): " << AR(3, 2) << " default: " << AR(4, 4) << std::endl;
+	
+	// test matrice booleana
+	SparsePattern<> PR(R);
+	SparsePattern<> diag(5, 5);
+	for (int i = 1; i <= 5; ++i)
+		diag.add(i, i);
+	SparsePattern<> piena(5, 200);
+	for (int j = 1; j <= 200; j += 2)
+		piena.add(3, j); // riga densa: passa al bitset
+	int archi = 0;
+	for (SparsePattern<>::const_iterator Pb = piena.begin(), Pe = piena.end(); Pb != Pe; ++Pb)
+		archi += ((*Pb).colonna % 2 == 1) ? 1 : 0;
+	std::cout << "pattern di R: " << PR.get_size() << " unione con diagonale: " << (PR | diag).get_size()
+		<< " intersezione: " << (PR & diag).get_size() << " differenza: " << (PR - diag).get_size()
+		<< " riga densa: " << archi << " " << piena(3, 199) << piena(3, 200) << std::endl;
+	
+	// test matrice simmetrica
+	SymmetricSparseMatrix<int> SY(4, 1);
+	SY.add(1, 1, 2);
+	SY.add(3, 1, 5); // memorizzato come (1;3)
+	SY.add(2, 4, 7);
+	int sx[] = {1, 2, 3, 4};
+	int sy[4], fy[4];
+	spmv(SY, sx, sy);
+	spmv(SY.expand(), sx, fy);
+	std::cout << "simmetrica (1;3) (3;1) size: " << SY(1, 3) << " " << SY(3, 1) << " " << SY.get_size()
+		<< " logiche: " << SY.expand().get_size() << " spmv:";
+	for (int k = 0; k < 4; ++k)
+		std::cout << " " << sy[k] << (sy[k] == fy[k] ? "" : "!");
+	std::cout << " evaluate divis_per_3: " << evaluate(SY, div3) << std::endl;
+	SparseMatrix<int> asimmetrica(SY.expand());
+	const size_t da_piena = SymmetricSparseMatrix<int>(asimmetrica).get_size();
+	asimmetrica.add(3, 1, 6); // (3;1) diverso da (1;3)
+	std::cout << "simmetrica da matrice piena size: " << da_piena << " asimmetrica rifiutata: ";
+	try {
+		SymmetricSparseMatrix<int> no(asimmetrica);
+		std::cout << "no" << std::endl;
+	}
+	catch (const std::invalid_argument&) {
+		std::cout << "si" << std::endl;
+	}
+	
+	// test formato a diagonali
+	SparseMatrix<double> tri(6, 6, 0.0);
+	for (int i = 1; i <= 6; ++i) {
+		tri.add(i, i, 2.0);
+		if (i > 1)
+			tri.add(i, i - 1, -1.0);
+		if (i < 6)
+			tri.add(i, i + 1, -1.0);
+	}
+	DiaSparseMatrix<double> DT(tri);
+	double tx[] = {1, 2, 3, 4, 5, 6};
+	double ty[6];
+	spmv(DT, tx, ty);
+	std::cout << "diagonali: " << DT.get_offsets().size() << " a banda: " << DiaSparseMatrix<double>::is_banded(tri)
+		<< " (5;4): " << DT(5, 4) << " (1;6): " << DT(1, 6) << " spmv:";
+	for (int k = 0; k < 6; ++k)
+		std::cout << " " << ty[k];
+	std::cout << " a banda R: " << DiaSparseMatrix<int>::is_banded(R) << std::endl;
+	
+	// test formato ibrido e scelta automatica
+	SparseMatrix<double> stella(6, 6, 0.0);
+	for (int j = 1; j <= 6; ++j)
+		stella.add(1, j, 1.0); // una riga lunga
+	for (int i = 2; i <= 6; ++i)
+		stella.add(i, 1, 1.0);
+	HybSparseMatrix<double> HS(stella);
+	AutoSparseMatrix<double> auto_stella(stella), auto_tri(tri);
+	stella.add(1, 1, 9.0); // la scelta automatica ha la sua copia: la sorgente si puo' modificare
+	double hy[6];
+	spmv(auto_stella, tx, hy);
+	std::cout << "HYB larghezza ELL: " << HS.get_ell_width() << " COO: " << HS.get_coo_size() << " (1;6): " << HS(1, 6)
+		<< " formato spmv stella: " << auto_stella.format_for(spmv_operation) << " tri: " << auto_tri.format_for(spmv_operation)
+		<< " y[0] y[5]: " << hy[0] << " " << hy[5] << std::endl;
+	
+	// test versioni con lettori concorrenti
+	SnapshotSparseMatrix<int> SN(50, 50, 0);
+	bool coerente = true;
+	std::thread lettore([&SN, &coerente]() {
+		SnapshotSparseMatrix<int>::reader R(SN);
+		for (int giro = 0; giro < 2000; ++giro) {
+			SnapshotSparseMatrix<int>::snapshot v(R);
+			const int n = (int)v->get_size();
+			for (int k = 1; k <= 50; ++k)
+				if ((*v)(k, k) != (k <= n ? k : 0))
+					coerente = false;
+		}
+	});
+	for (int k = 1; k <= 50; ++k) {
+		SN.add(k, k, k);
+		SN.publish();
+	}
+	lettore.join();
+	SnapshotSparseMatrix<int>::reader RN(SN);
+	std::cout << "versioni: " << SN.get_version() << " (50;50): " << RN.get(50, 50) << " lettore coerente: " << coerente;
+	SN.publish(); // nessuno snapshot aperto: tutta la memoria sostituita viene liberata
+	std::cout << " in attesa: " << SN.get_pending() << std::endl;
+	
+	// test inserimento concorrente
+	ConcurrentSparseMatrix<int> CC(8, 100, 0);
+	std::vector<std::thread> costruttori;
+	for (int t = 0; t < 4; ++t)
+		costruttori.push_back(std::thread([&CC, t]() {
+			for (int j = 1; j <= 100; ++j)
+				CC.add(1 + (j + t) % 8, j, j); // i thread si sovrappongono sulle stesse righe
+		}));
+	for (size_t t = 0; t < costruttori.size(); ++t)
+		costruttori[t].join();
+	SparseMatrix<int> da_concorrente = CC.to_matrix();
+	std::cout << "inserimento concorrente size: " << CC.get_size() << " lista: " << da_concorrente.get_size()
+		<< " (3;2): " << CC(3, 2) << " prima riga: " << (*CC.begin()).riga << std::endl;
+	
+	// test matrice divisa per righe
+	ShardedSparseMatrix<int> SH(10, 10, 0, 3);
+	std::vector<std::thread> scrittori;
+	for (int t = 0; t < 3; ++t)
+		scrittori.push_back(std::thread([&SH, t]() {
+			for (int i = 1 + 4 * t; i <= 4 + 4 * t && i <= 10; ++i) // ogni thread su un blocco diverso
+				for (int j = 1; j <= 10; j += 3)
+					SH.add(i, j, i * j);
+		}));
+	for (size_t t = 0; t < scrittori.size(); ++t)
+		scrittori[t].join();
+	int ultima = 0;
+	bool ordinata = true;
+	for (ShardedSparseMatrix<int>::const_iterator Sb = SH.begin(), Se = SH.end(); Sb != Se; ++Sb) {
+		ordinata = ordinata && (*Sb).riga >= ultima;
+		ultima = (*Sb).riga;
+	}
+	std::cout << "blocchi: " << SH.get_shards() << " size: " << SH.get_size() << " (7;4): " << SH(7, 4)
+		<< " ordine naturale: " << ordinata << " ultima riga: " << ultima << std::endl;
+	
+	// test esecuzione parallela con furto di lavoro
+	SparseMatrix<double> potenza(100, 10000, 0.0);
+	std::vector<SparseMatrix<double>::element> archi_potenza;
+	for (int j = 1; j <= 10000; ++j)
+		archi_potenza.push_back(SparseMatrix<double>::element(1, j, 1.0)); // una riga con quasi tutti gli elementi
+	for (int i = 2; i <= 100; ++i)
+		archi_potenza.push_back(SparseMatrix<double>::element(i, i, 2.0));
+	potenza.scatter(archi_potenza);
+	SoASparseMatrix<double> AP(potenza);
+	std::vector<double> px(10000, 1.0), py(100), py_seriale(100);
+	spmv(AP, px.data(), py.data(), 4);
+	spmv(AP, px.data(), py_seriale.data());
+	std::cout << "spmv parallelo y[0] y[99]: " << py[0] << " " << py[99] << " uguale al seriale: " << (py == py_seriale)
+		<< " evaluate parallelo su R: " << evaluate(AR, div3, 4) << std::endl;
+	std::vector<double> py_lista(100);
+	spmv(potenza, px.data(), py_lista.data(), 4);
+	SparseMatrix<int> R_doppia(R);
+	R_doppia.transform_values([](const int v) { return 2 * v; }, 3);
+	std::cout << "lista: spmv parallelo uguale al seriale: " << (py_lista == py_seriale) << " evaluate parallelo su R: " << evaluate(R, div3, 4)
+		<< " (seriale: " << evaluate(R, div3) << ") R doppia (3;2): " << R_doppia(3, 2) << " su " << R(3, 2) << std::endl;
+	
+	// test intervalli divisibili
+	std::vector<SparseMatrix<int>::const_view> parti_R = static_cast<const SparseMatrix<int>&>(R).rows_view(1, 5).partition(3);
+	std::vector<int> somme_parti(parti_R.size(), 0);
+	parallel_for(parti_R.size(), [&parti_R, &somme_parti](const size_t k) {
+		for (SparseMatrix<int>::const_view::iterator Vb = parti_R[k].begin(), Ve = parti_R[k].end(); Vb != Ve; ++Vb)
+			somme_parti[k] += (*Vb).dato;
+	}, 3);
+	SoASparseMatrix<int>::range tutto = AR.all();
+	std::pair<SoASparseMatrix<int>::range, SoASparseMatrix<int>::range> meta = tutto.split_rows();
+	std::cout << "parti di R: " << parti_R.size() << " somme: " << somme_parti[0] << " " << somme_parti[1] << " " << somme_parti[2]
+		<< " SoA diviso per righe: " << meta.first.size() << "+" << meta.second.size() << " righe (3;5): " << AR.row_range(3, 5).size() << std::endl;
+	
+	// test partizioni NUMA
+	NumaSparseMatrix<double> NP(potenza, 4);
+	std::vector<double> ny(100);
+	spmv(NP, px.data(), ny.data());
+	std::cout << "partizioni: " << NP.get_partitions() << " prima: [" << NP.partition_rows(0).first << ";" << NP.partition_rows(0).second
+		<< ") spmv uguale al seriale: " << (ny == py_seriale) << " (50;50): " << NP(50, 50) << std::endl;
+	
+	// test accesso casuale
+	SoASparseMatrix<int>::const_iterator da_riga_3 = std::lower_bound(AR.begin(), AR.end(), 3, riga_minore());
+	std::cout << "primo elemento della riga 3: posizione " << (da_riga_3 - AR.begin()) << " (" << (*da_riga_3).riga << ";" << (*da_riga_3).colonna
+		<< ") AR[0]: " << AR[0].dato << " distanza: " << std::distance(AR.begin(), AR.end()) << std::endl;
+	
+	// test iteratore denso
+	std::cout << "R in ordine denso, riga 3:";
+	for (SparseMatrix<int>::dense_iterator Db = R.dense_begin(), De = R.dense_end(); Db != De; ++Db)
+		if (Db.riga() == 3)
+			std::cout << " " << *Db << (Db.stored() ? "" : "*");
+	std::cout << " (* = default)" << std::endl;
+	
 	// test operator()
 	std::cout << "Valore in (2;2): " << I(2, 2) << std::endl;
 	std::cout << "Valore in (3;2): " << I(3, 2) << std::endl;
@@ -72,6 +510,9 @@ int main() {
 #ifdef DEBUG
 	K.print();
 #endif
+	SparseMatrix<int> A(1, 1, 0);
+	A = I;
+	std::cout << "Valore in (3;1) dopo assegnamento: " << A(3, 1) << std::endl;
 	SparseMatrix<long> l(5, 5, 999999);
 	SparseMatrix<double> d(l);
 	
@@ -92,6 +533,14 @@ int main() {
 	SparseMatrix<int>::element e(*(I_c));
 	std::cout << "elemento: " << (*Ib).dato << " casella: " << I(1, 1) << std::endl;
 	
+	// test iteratori all'indietro
+	std::cout << "R all'indietro:";
+	for (SparseMatrix<int>::const_reverse_iterator Rb = R.rbegin(), Re = R.rend(); Rb != Re; ++Rb)
+		std::cout << " (" << Rb->riga << ";" << Rb->colonna << ")";
+	Ie = R.end();
+	--Ie;
+	std::cout << " ultimo da --end(): " << (*Ie).dato << std::endl;
+	
 	// test static_cast
 	SparseMatrix<double> D(5, 5, 999);
 	D.add(1, 1, 150);